@@ -0,0 +1,117 @@
+// AllocationCounter.cpp
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<quint64> allocationCount{0};
+std::atomic<quint64> allocationBytes{0};
+
+inline void record(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+} // namespace
+
+quint64 AllocationCounter::count() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+quint64 AllocationCounter::bytes() {
+    return allocationBytes.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+
+// Definitions in the executable take precedence over the ones in libc.
+// operator new goes through malloc, and aligned operator new through
+// aligned_alloc, so both are counted here as well. glibc only exports
+// memalign among the aligned functions, so the others are built on it.
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void *__libc_valloc(std::size_t size);
+void *__libc_pvalloc(std::size_t size);
+
+void *malloc(std::size_t size) {
+    record(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) {
+    record(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size) {
+    record(size);
+    return __libc_realloc(pointer, size);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) {
+    record(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) {
+    record(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, std::size_t alignment, std::size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    record(size);
+    void *result = __libc_memalign(alignment, size);
+    if (!result) {
+        return ENOMEM;
+    }
+    *pointer = result;
+    return 0;
+}
+
+void *valloc(std::size_t size) {
+    record(size);
+    return __libc_valloc(size);
+}
+
+void *pvalloc(std::size_t size) {
+    record(size);
+    return __libc_pvalloc(size);
+}
+}
+
+bool AllocationCounter::tracksCAllocations() {
+    return true;
+}
+
+#else
+
+void *operator new(std::size_t size) {
+    record(size);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+bool AllocationCounter::tracksCAllocations() {
+    return false;
+}
+
+#endif
@@ -0,0 +1,18 @@
+// AllocationCounter.h
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Counts heap allocations made by the whole process. With glibc the C
+// allocation functions are wrapped, the aligned ones included, which also
+// covers Qt's containers; elsewhere only operator new is counted, without
+// its aligned overloads.
+class AllocationCounter {
+public:
+    static quint64 count();
+    static quint64 bytes();
+    static bool tracksCAllocations();
+};
+
+#endif // ALLOCATIONCOUNTER_H
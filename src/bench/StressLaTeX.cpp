@@ -0,0 +1,125 @@
+// StressLaTeX.cpp
+#include "StressLaTeX.h"
+#include "SyntheticLaTeX.h"
+#include <QRandomGenerator>
+#include <algorithm>
+
+namespace {
+
+// Tokens inserted by mutations: delimiters, environments and commands that
+// change the scan state for the rest of the document
+const char *const Fragments[] = {
+    "{", "}", "[", "]", "$", "$$", "\\(", "\\)", "\\[", "\\]", "\\", "\\\\", "%", "&", "\n",
+    "\\begin{itemize}", "\\end{itemize}", "\\begin{tabular}{", "\\end{tabular}",
+    "\\begin{verbatim}", "\\end{verbatim}", "\\begin{document}", "\\end{document}",
+    "\\verb|", "\\documentclass[", "\\usepackage{", "\\section{", "\\frac{", "\\item "
+};
+
+QString repeated(const char *text, int count) {
+    return QString::fromLatin1(text).repeated(std::max(1, count));
+}
+
+// Pieces repeated to fill the line; 'text' is about 'size' characters
+QString fill(const char *const *pieces, int pieceCount, int size) {
+    QString text;
+    text.reserve(size + 32);
+    for (int i = 0; text.size() < size; ++i) {
+        text += QLatin1String(pieces[i % pieceCount]);
+    }
+    return text;
+}
+
+} // namespace
+
+QList<StressCase> StressLaTeX::generate(int size) {
+    size = std::max(size, 16);
+    QList<StressCase> cases;
+    auto add = [&cases](const char *name, const QString &content) {
+        cases.append(StressCase{QLatin1String(name), content});
+    };
+
+    // Nesting
+    add("nested-braces", repeated("{", size / 2) + QLatin1Char('x') + repeated("}", size / 2));
+    add("unclosed-braces", repeated("\\textbf{", size / 8));
+    add("stray-closing-braces", repeated("}", size));
+    add("nested-environments", repeated("\\begin{itemize}\n", size / 32) + QLatin1String("\\item x\n")
+        + repeated("\\end{itemize}\n", size / 32));
+    add("nested-math", QLatin1String("$") + repeated("\\frac{", size / 14)
+        + repeated("1}{2}", size / 14) + QLatin1String("$\n"));
+
+    // Very long lines
+    static const char *const words[] = {
+        "lorem ", "\\textbf{ipsum} ", "dolor ", "$x_{i}$ ", "sit ", "\\emph{amet} ", "a = b ", "\\\\ "
+    };
+    add("long-line", fill(words, 8, size) + QLatin1Char('\n'));
+    add("long-line-unclosed-math", QLatin1String("$") + repeated("x + ", size / 4) + QLatin1Char('\n'));
+    add("long-comment-line", QLatin1String("%") + fill(words, 8, size) + QLatin1Char('\n'));
+    add("long-line-spaces", QLatin1Char('x') + QString(size, QLatin1Char(' ')) + QLatin1String("x\n"));
+    add("long-line-commands", repeated("\\a", size / 2) + QLatin1Char('\n'));
+
+    // Unbalanced structure
+    QString environments;
+    for (int i = 0; environments.size() < size; ++i) {
+        environments += QString("\\begin{env%1}\n\\end{env%2}\n").arg(i).arg(i + 1);
+    }
+    add("mismatched-environments", environments);
+    add("unclosed-environments", repeated("\\begin{center}\n", size / 15));
+    add("unopened-environments", repeated("\\end{center}\n", size / 13));
+    add("unclosed-display-math", repeated("\\[ x ", size / 5));
+    add("unclosed-verbatim", QLatin1String("\\begin{verbatim}\n") + repeated("\\begin{x} { $ %\n", size / 16));
+    add("unclosed-verb", repeated("\\verb|x ", size / 8) + QLatin1Char('\n'));
+    add("packages-after-document", QLatin1String("\\begin{document}\n")
+        + repeated("\\usepackage{graphicx}\n", size / 22));
+
+    // Inputs where a lazy or optional group would be retried from every
+    // position: openers without their closing delimiter
+    add("unclosed-documentclass-options", QLatin1String("\\documentclass[") + repeated("a,", size / 2)
+        + QLatin1String("\n{article\n"));
+    add("repeated-documentclass", repeated("\\documentclass[x]{", size / 18) + QLatin1Char('\n'));
+    add("unclosed-tabular", QLatin1String("\\begin{tabular}{") + repeated("c", 64) + QLatin1String("}\n")
+        + repeated("a & b & c \\\\\n", size / 13));
+    add("repeated-tabular-openers", repeated("\\begin{tabular}{c} x & y ", size / 25) + QLatin1Char('\n'));
+    add("backslash-run", repeated("\\", size));
+    add("dollar-run", repeated("$", size));
+    add("ampersand-run", repeated("&", size));
+    add("empty-lines", repeated("\n", size));
+    return cases;
+}
+
+QList<StressCase> StressLaTeX::mutate(int count, int lineCount, quint32 seed) {
+    QList<StressCase> cases;
+    for (int i = 0; i < count; ++i) {
+        const quint32 caseSeed = seed + static_cast<quint32>(i);
+        QString text = SyntheticLaTeX::generate(lineCount, SyntheticMix(), caseSeed);
+        QRandomGenerator random(caseSeed);
+
+        const int edits = 1 + static_cast<int>(random.bounded(std::max(1, lineCount / 4)));
+        for (int i = 0; i < edits && !text.isEmpty(); ++i) {
+            edit(text, random);
+        }
+        cases.append(StressCase{QString("mutation-%1").arg(caseSeed), text});
+    }
+    return cases;
+}
+
+void StressLaTeX::edit(QString &text, QRandomGenerator &random) {
+    const int fragmentCount = static_cast<int>(sizeof(Fragments) / sizeof(Fragments[0]));
+    if (text.isEmpty()) {
+        text = QLatin1String(Fragments[random.bounded(fragmentCount)]);
+        return;
+    }
+
+    const qsizetype pos = random.bounded(text.size());
+    const qsizetype length = std::min<qsizetype>(1 + random.bounded(8), text.size() - pos);
+    switch (random.bounded(3)) {
+        case 0:
+            text.remove(pos, length);
+            break;
+        case 1:
+            text.insert(pos, text.mid(pos, length));
+            break;
+        default:
+            text.insert(pos, QLatin1String(Fragments[random.bounded(fragmentCount)]));
+            break;
+    }
+}
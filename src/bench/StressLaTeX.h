@@ -0,0 +1,32 @@
+// StressLaTeX.h
+#ifndef STRESSLATEX_H
+#define STRESSLATEX_H
+
+#include <QList>
+#include <QString>
+
+class QRandomGenerator;
+
+struct StressCase {
+    QString name;      // Also the file name the input is recorded under
+    QString content;
+};
+
+// Generates inputs meant to hit the worst cases of the checker and the
+// converter rather than typical documents: deep nesting, very long lines,
+// unbalanced structure and text that would make a lazy or nested regex
+// backtrack.
+class StressLaTeX {
+public:
+    // One input per construct, each about 'size' characters long
+    static QList<StressCase> generate(int size);
+
+    // Synthetic documents of 'lineCount' lines with random edits that break
+    // their structure: dropped, doubled and inserted delimiters and commands
+    static QList<StressCase> mutate(int count, int lineCount, quint32 seed);
+
+    // One random edit of the kind mutate() makes
+    static void edit(QString &text, QRandomGenerator &random);
+};
+
+#endif // STRESSLATEX_H
@@ -0,0 +1,184 @@
+// SyntheticLaTeX.cpp
+#include "SyntheticLaTeX.h"
+#include <QRandomGenerator>
+#include <QStringList>
+
+namespace {
+
+const char *const Words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+    "magna", "aliqua", "theorem", "proof", "lemma", "function", "matrix", "vector"
+};
+
+class Generator {
+public:
+    explicit Generator(quint32 seed) : m_random(seed), m_lines(0) {}
+
+    int lines() const { return m_lines; }
+    QString &text() { return m_text; }
+
+    void line(const QString &text = QString()) {
+        m_text += text;
+        m_text += QLatin1Char('\n');
+        ++m_lines;
+    }
+
+    int bounded(int limit) { return static_cast<int>(m_random.bounded(limit)); }
+
+    QString word() {
+        return QLatin1String(Words[bounded(static_cast<int>(sizeof(Words) / sizeof(Words[0])))]);
+    }
+
+    QString sentence() {
+        QString result;
+        const int count = 8 + bounded(10);
+        for (int i = 0; i < count; ++i) {
+            if (i > 0) {
+                result += QLatin1Char(' ');
+            }
+            switch (bounded(20)) {
+                case 0: result += QLatin1String("\\textbf{") + word() + QLatin1Char('}'); break;
+                case 1: result += QLatin1String("\\emph{") + word() + QLatin1Char('}'); break;
+                case 2: result += QLatin1Char('$') + word().left(1) + QLatin1String("_{i}$"); break;
+                case 3: result += QLatin1String("``") + word() + QLatin1String("''"); break;
+                case 4: result += word() + QLatin1String("--") + word(); break;
+                default: result += word(); break;
+            }
+        }
+        return result + QLatin1Char('.');
+    }
+
+    void paragraph() {
+        const int count = 3 + bounded(4);
+        for (int i = 0; i < count; ++i) {
+            line(bounded(10) == 0 ? sentence() + QLatin1String(" % ") + word() : sentence());
+        }
+        line();
+    }
+
+    void math() {
+        switch (bounded(3)) {
+            case 0:
+                line(QLatin1String("\\begin{equation}"));
+                line(QLatin1String("    f(x) = \\frac{1}{\\sqrt{2\\pi}} \\int_{-\\infty}^{x} e^{-t^2/2}\\,dt"));
+                line(QLatin1String("\\end{equation}"));
+                break;
+            case 1:
+                line(QLatin1String("\\begin{align}"));
+                line(QLatin1String("    a &= b + c \\\\"));
+                line(QLatin1String("    d &= \\sum_{k=1}^{n} k^2"));
+                line(QLatin1String("\\end{align}"));
+                break;
+            default:
+                line(QLatin1String("\\[ \\lim_{n \\to \\infty} \\left(1 + \\frac{1}{n}\\right)^n = e \\]"));
+                break;
+        }
+        line();
+    }
+
+    void table() {
+        line(QLatin1String("\\begin{table}[h]"));
+        line(QLatin1String("\\begin{tabular}{|l|c|r|}"));
+        line(QLatin1String("\\hline"));
+        const int rows = 3 + bounded(5);
+        for (int i = 0; i < rows; ++i) {
+            line(word() + QLatin1String(" & ") + word() + QLatin1String(" & ")
+                 + QString::number(bounded(1000)) + QLatin1String(" \\\\"));
+        }
+        line(QLatin1String("\\hline"));
+        line(QLatin1String("\\end{tabular}"));
+        line(QLatin1String("\\caption{") + word() + QLatin1Char('}'));
+        line(QLatin1String("\\end{table}"));
+        line();
+    }
+
+    void list() {
+        const bool ordered = bounded(2) == 0;
+        line(ordered ? QLatin1String("\\begin{enumerate}") : QLatin1String("\\begin{itemize}"));
+        const int items = 3 + bounded(4);
+        for (int i = 0; i < items; ++i) {
+            line(QLatin1String("    \\item ") + sentence());
+        }
+        line(ordered ? QLatin1String("\\end{enumerate}") : QLatin1String("\\end{itemize}"));
+        line();
+    }
+
+    void section() {
+        const QString title = word() + QLatin1Char(' ') + word();
+        line((bounded(3) == 0 ? QLatin1String("\\subsection{") : QLatin1String("\\section{"))
+             + title + QLatin1Char('}'));
+        line();
+    }
+
+private:
+    QRandomGenerator m_random;
+    QString m_text;
+    int m_lines;
+};
+
+} // namespace
+
+bool SyntheticMix::parse(const QString &spec) {
+    const QStringList parts = spec.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        const QStringList pair = part.split(QLatin1Char('='));
+        bool ok = false;
+        const int weight = pair.size() == 2 ? pair[1].trimmed().toInt(&ok) : 0;
+        if (!ok || weight < 0) {
+            return false;
+        }
+
+        const QString key = pair[0].trimmed();
+        if (key == QLatin1String("paragraphs")) {
+            paragraphs = weight;
+        } else if (key == QLatin1String("math")) {
+            math = weight;
+        } else if (key == QLatin1String("tables")) {
+            tables = weight;
+        } else if (key == QLatin1String("lists")) {
+            lists = weight;
+        } else if (key == QLatin1String("sections")) {
+            sections = weight;
+        } else {
+            return false;
+        }
+    }
+    return paragraphs + math + tables + lists + sections > 0;
+}
+
+QString SyntheticMix::toString() const {
+    return QString("paragraphs=%1,math=%2,tables=%3,lists=%4,sections=%5")
+        .arg(paragraphs).arg(math).arg(tables).arg(lists).arg(sections);
+}
+
+QString SyntheticLaTeX::generate(int lineCount, const SyntheticMix &mix, quint32 seed) {
+    Generator generator(seed);
+    generator.text().reserve(static_cast<qsizetype>(lineCount) * 64);
+
+    generator.line(QLatin1String("\\documentclass{article}"));
+    generator.line(QLatin1String("\\usepackage{amsmath}"));
+    generator.line(QLatin1String("\\title{Synthetic benchmark document}"));
+    generator.line(QLatin1String("\\begin{document}"));
+    generator.line(QLatin1String("\\maketitle"));
+    generator.line();
+
+    const int total = mix.paragraphs + mix.math + mix.tables + mix.lists + mix.sections;
+    while (total > 0 && generator.lines() < lineCount - 1) {
+        int pick = generator.bounded(total);
+        if ((pick -= mix.paragraphs) < 0) {
+            generator.paragraph();
+        } else if ((pick -= mix.math) < 0) {
+            generator.math();
+        } else if ((pick -= mix.tables) < 0) {
+            generator.table();
+        } else if ((pick -= mix.lists) < 0) {
+            generator.list();
+        } else {
+            generator.section();
+        }
+    }
+
+    generator.line(QLatin1String("\\end{document}"));
+    return generator.text();
+}
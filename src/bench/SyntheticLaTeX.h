@@ -0,0 +1,26 @@
+// SyntheticLaTeX.h
+#ifndef SYNTHETICLATEX_H
+#define SYNTHETICLATEX_H
+
+#include <QString>
+
+// Relative weights of the constructs in a generated document
+struct SyntheticMix {
+    int paragraphs = 50;
+    int math = 20;
+    int tables = 10;
+    int lists = 10;
+    int sections = 5;
+
+    // Parses "paragraphs=50,math=20,..."; unknown keys make it return false
+    bool parse(const QString &spec);
+    QString toString() const;
+};
+
+// Generates reproducible LaTeX documents of a given size for benchmarking
+class SyntheticLaTeX {
+public:
+    static QString generate(int lineCount, const SyntheticMix &mix, quint32 seed = 1);
+};
+
+#endif // SYNTHETICLATEX_H
@@ -0,0 +1,249 @@
+// latexbench.cpp
+// Measures the LaTeX to HTML conversion on generated documents and prints the
+// results as JSON: time, throughput and allocations per stage, and peak RSS.
+// Peak RSS is a high-water mark of the whole process, so with several sizes
+// each document is benchmarked by a child process of its own.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include "AllocationCounter.h"
+#include "SyntheticLaTeX.h"
+#include "../utils/LaTeXBlockSplitter.h"
+#include "../utils/LaTeXToHtmlConverter.h"
+#include "../utils/LaTeXTokenizer.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Discards everything written to it, so streaming output costs no memory
+class NullDevice : public QIODevice {
+protected:
+    qint64 readData(char *, qint64) override { return -1; }
+    qint64 writeData(const char *, qint64 size) override { return size; }
+};
+
+qint64 peakRssKiB() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+    }
+    return -1;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#if defined(Q_OS_MACOS)
+    return usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    return usage.ru_maxrss;         // KiB elsewhere
+#endif
+#else
+    return -1;
+#endif
+}
+
+// Runs a stage 'iterations' times and reports the fastest run, its time and
+// its allocations. The stage returns a size so the work cannot be optimized
+// away.
+QJsonObject measure(int iterations, qint64 inputBytes, const std::function<qsizetype()> &stage) {
+    qint64 bestNs = std::numeric_limits<qint64>::max();
+    quint64 allocations = 0;
+    quint64 allocatedBytes = 0;
+    qsizetype outputSize = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        const quint64 countBefore = AllocationCounter::count();
+        const quint64 bytesBefore = AllocationCounter::bytes();
+        QElapsedTimer timer;
+        timer.start();
+
+        outputSize = stage();
+
+        const qint64 elapsedNs = timer.nsecsElapsed();
+        if (elapsedNs < bestNs) {
+            bestNs = elapsedNs;
+            allocations = AllocationCounter::count() - countBefore;
+            allocatedBytes = AllocationCounter::bytes() - bytesBefore;
+        }
+    }
+
+    const double seconds = bestNs / 1e9;
+    QJsonObject result;
+    result["ms"] = bestNs / 1e6;
+    result["mbPerSec"] = seconds > 0 ? inputBytes / (1024.0 * 1024.0) / seconds : 0.0;
+    result["allocations"] = static_cast<qint64>(allocations);
+    result["allocatedBytes"] = static_cast<qint64>(allocatedBytes);
+    result["outputSize"] = static_cast<qint64>(outputSize);
+    return result;
+}
+
+QJsonObject benchmarkDocument(int lineCount, const SyntheticMix &mix, quint32 seed, int iterations) {
+    const QString source = SyntheticLaTeX::generate(lineCount, mix, seed);
+    const qint64 inputBytes = source.toUtf8().size();
+
+    LaTeXToHtmlConverter converter;
+    const QString body = converter.convertBody(source);
+
+    QJsonObject stages;
+    stages["split"] = measure(iterations, inputBytes, [&]() {
+        return LaTeXBlockSplitter::split(source).size();
+    });
+    stages["tokenize"] = measure(iterations, inputBytes, [&]() {
+        LaTeXTokenizer tokenizer(source);
+        qsizetype tokens = 0;
+        while (tokenizer.next().type != LaTeXToken::End) {
+            ++tokens;
+        }
+        return tokens;
+    });
+    stages["body"] = measure(iterations, inputBytes, [&]() {
+        return converter.convertBody(source).size();
+    });
+    stages["bodyConcurrent"] = measure(iterations, inputBytes, [&]() {
+        return converter.convertBodyConcurrent(source).size();
+    });
+    stages["document"] = measure(iterations, inputBytes, [&]() {
+        return converter.generateHtmlDocument(body, true).size();
+    });
+    stages["endToEnd"] = measure(iterations, inputBytes, [&]() {
+        return converter.convertToHtml(source, true).size();
+    });
+    stages["streaming"] = measure(iterations, inputBytes, [&]() {
+        NullDevice output;
+        output.open(QIODevice::WriteOnly);
+        converter.convertToHtml(QStringView(source), &output, true);
+        return static_cast<qsizetype>(output.pos());
+    });
+
+    QJsonObject result;
+    result["lines"] = lineCount;
+    result["inputBytes"] = inputBytes;
+    result["stages"] = stages;
+    result["peakRssKiB"] = peakRssKiB();
+    return result;
+}
+
+// Runs latexbench again for one document size and takes its result
+bool benchmarkInChild(int lines, const SyntheticMix &mix, quint32 seed, int iterations, QJsonObject &document,
+                      QTextStream &err) {
+    QProcess child;
+    child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    child.start(QCoreApplication::applicationFilePath(), QStringList()
+                << "--lines" << QString::number(lines)
+                << "--mix" << mix.toString()
+                << "--iterations" << QString::number(iterations)
+                << "--seed" << QString::number(seed));
+    if (!child.waitForFinished(-1) || child.exitStatus() != QProcess::NormalExit || child.exitCode() != 0) {
+        err << "Benchmark of " << lines << " lines failed: " << child.errorString() << Qt::endl;
+        return false;
+    }
+
+    const QJsonArray documents = QJsonDocument::fromJson(child.readAllStandardOutput())
+                                     .object().value("documents").toArray();
+    if (documents.size() != 1) {
+        err << "Benchmark of " << lines << " lines gave no result" << Qt::endl;
+        return false;
+    }
+    document = documents.first().toObject();
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("latexbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the LaTeX to HTML conversion on synthetic documents.");
+    parser.addHelpOption();
+
+    QCommandLineOption linesOption("lines", "Comma-separated document sizes in lines.", "sizes",
+                                   "1000,10000,100000,1000000");
+    QCommandLineOption mixOption("mix", "Construct weights, e.g. paragraphs=50,math=20,tables=10,lists=10,sections=5.",
+                                 "weights", SyntheticMix().toString());
+    QCommandLineOption iterationsOption("iterations", "Runs per stage; the fastest is reported.", "count", "3");
+    QCommandLineOption seedOption("seed", "Seed of the document generator.", "seed", "1");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON report to a file.", "file");
+    parser.addOption(linesOption);
+    parser.addOption(mixOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(seedOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    SyntheticMix mix;
+    if (!mix.parse(parser.value(mixOption))) {
+        err << "Invalid mix: " << parser.value(mixOption) << Qt::endl;
+        return 1;
+    }
+
+    QList<int> sizes;
+    for (const QString &value : parser.value(linesOption).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int lines = value.trimmed().toInt(&ok);
+        if (!ok || lines <= 0) {
+            err << "Invalid document size: " << value << Qt::endl;
+            return 1;
+        }
+        sizes.append(lines);
+    }
+
+    const int iterations = std::max(1, parser.value(iterationsOption).toInt());
+    const quint32 seed = parser.value(seedOption).toUInt();
+
+    QJsonArray documents;
+    if (sizes.size() == 1) {
+        err << "Benchmarking " << sizes.first() << " lines..." << Qt::endl;
+        documents.append(benchmarkDocument(sizes.first(), mix, seed, iterations));
+    } else {
+        for (int lines : sizes) {
+            QJsonObject document;
+            if (!benchmarkInChild(lines, mix, seed, iterations, document, err)) {
+                return 1;
+            }
+            documents.append(document);
+        }
+    }
+
+    QJsonObject report;
+    report["benchmark"] = "latex-to-html";
+    report["mix"] = mix.toString();
+    report["seed"] = static_cast<qint64>(seed);
+    report["iterations"] = iterations;
+    report["allocationsIncludeQtContainers"] = AllocationCounter::tracksCAllocations();
+    report["documents"] = documents;
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Cannot write " << file.fileName() << ": " << file.errorString() << Qt::endl;
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+// latexfuzz.cpp
+// libFuzzer target for the error checker and the HTML converter. Each input
+// is decoded as UTF-8 and passed to checkDocument and convertToHtml.
+//
+// libFuzzer records inputs that crash, run longer than -timeout seconds or
+// use more than -rss_limit_mb or -malloc_limit_mb. For a finer time budget,
+// set LATEXFUZZ_BUDGET_MS: a stage that takes longer aborts, and the input is
+// saved like a crash. Seed the corpus with "latexstress --corpus <dir>" and
+// raise -max_len so inputs can grow to long lines, for example:
+//
+//     latexfuzz -max_len=200000 -timeout=10 -rss_limit_mb=2048 corpus/
+//
+// Saved inputs can be replayed with latexstress to check them against its budget.
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QString>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "../utils/LaTeXErrorChecker.h"
+#include "../utils/LaTeXToHtmlConverter.h"
+
+namespace {
+
+qint64 budgetMs = 0;
+
+void checkBudget(const char *stage, const QElapsedTimer &timer) {
+    if (budgetMs > 0 && timer.elapsed() > budgetMs) {
+        std::fprintf(stderr, "latexfuzz: %s took %lld ms, budget is %lld ms\n",
+                     stage, static_cast<long long>(timer.elapsed()), static_cast<long long>(budgetMs));
+        std::abort();
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    // The command database reads settings, which need an application
+    static QCoreApplication app(*argc, *argv);
+    QCoreApplication::setApplicationName("latexfuzz");
+    budgetMs = qEnvironmentVariableIntValue("LATEXFUZZ_BUDGET_MS");
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static LaTeXErrorChecker checker;
+    static LaTeXToHtmlConverter converter;
+
+    const QString content = QString::fromUtf8(reinterpret_cast<const char *>(data), static_cast<qsizetype>(size));
+
+    QElapsedTimer timer;
+    timer.start();
+    checker.checkDocument(content);
+    checkBudget("checkDocument", timer);
+
+    timer.restart();
+    converter.convertToHtml(content);
+    checkBudget("convertToHtml", timer);
+    return 0;
+}
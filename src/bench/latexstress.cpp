@@ -0,0 +1,194 @@
+// latexstress.cpp
+// Runs the error checker and the HTML converter on generated worst-case
+// inputs and on input files, and records every input that takes longer or
+// allocates more than the budget. Each input is written to the output
+// directory before it runs and removed if it stays within budget, so an input
+// that hangs or crashes the process is kept as well. Exits with status 2 if
+// any input was recorded, so scripts and CI jobs can catch regressions.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include "AllocationCounter.h"
+#include "StressLaTeX.h"
+#include "../utils/LaTeXErrorChecker.h"
+#include "../utils/LaTeXToHtmlConverter.h"
+
+namespace {
+
+struct Budget {
+    qint64 timeMs = 0;
+    quint64 allocatedBytes = 0;
+};
+
+// Runs one stage once; the stage returns a size so its work cannot be optimized away
+QJsonObject measure(const Budget &budget, const std::function<qsizetype()> &stage, bool &overBudget) {
+    const quint64 bytesBefore = AllocationCounter::bytes();
+    QElapsedTimer timer;
+    timer.start();
+
+    const qsizetype outputSize = stage();
+
+    const qint64 elapsedNs = timer.nsecsElapsed();
+    const quint64 allocatedBytes = AllocationCounter::bytes() - bytesBefore;
+    const bool slow = elapsedNs > budget.timeMs * 1000000;
+    const bool large = allocatedBytes > budget.allocatedBytes;
+    overBudget = overBudget || slow || large;
+
+    QJsonObject result;
+    result["ms"] = elapsedNs / 1e6;
+    result["allocatedBytes"] = static_cast<qint64>(allocatedBytes);
+    result["outputSize"] = static_cast<qint64>(outputSize);
+    result["overTimeBudget"] = slow;
+    result["overMemoryBudget"] = large;
+    return result;
+}
+
+bool writeFile(const QString &path, const QString &content, QTextStream &err) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        err << "Cannot write " << path << ": " << file.errorString() << Qt::endl;
+        return false;
+    }
+    file.write(content.toUtf8());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("latexstress");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks that the error checker and the HTML converter stay within a time "
+                                     "and memory budget on worst-case inputs.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Additional inputs, such as inputs saved by latexfuzz.", "[files...]");
+
+    QCommandLineOption sizeOption("size", "Length of each generated input in characters.", "chars", "100000");
+    QCommandLineOption mutationsOption("mutations", "Number of randomly edited synthetic documents.", "count", "50");
+    QCommandLineOption mutationLinesOption("mutation-lines", "Length of each edited document in lines.", "lines",
+                                           "2000");
+    QCommandLineOption seedOption("seed", "Seed of the random edits.", "seed", "1");
+    QCommandLineOption timeOption("time-budget", "Time allowed per stage and input.", "ms", "2000");
+    QCommandLineOption memoryOption("memory-budget", "Memory allowed to be allocated per stage and input.", "MiB",
+                                    "512");
+    QCommandLineOption outputOption("output", "Directory the inputs over budget are recorded in.", "dir",
+                                    "stress-failures");
+    QCommandLineOption corpusOption("corpus", "Write the generated inputs to a directory, for example to seed "
+                                    "latexfuzz, instead of running them.", "dir");
+    QCommandLineOption reportOption(QStringList() << "o" << "report", "Write the JSON report to a file.", "file");
+    parser.addOption(sizeOption);
+    parser.addOption(mutationsOption);
+    parser.addOption(mutationLinesOption);
+    parser.addOption(seedOption);
+    parser.addOption(timeOption);
+    parser.addOption(memoryOption);
+    parser.addOption(outputOption);
+    parser.addOption(corpusOption);
+    parser.addOption(reportOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    QList<StressCase> cases = StressLaTeX::generate(parser.value(sizeOption).toInt());
+    cases += StressLaTeX::mutate(std::max(0, parser.value(mutationsOption).toInt()),
+                                 std::max(1, parser.value(mutationLinesOption).toInt()),
+                                 parser.value(seedOption).toUInt());
+    for (const QString &path : parser.positionalArguments()) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            err << "Cannot read " << path << ": " << file.errorString() << Qt::endl;
+            return 1;
+        }
+        cases.append(StressCase{QFileInfo(path).completeBaseName(), QString::fromUtf8(file.readAll())});
+    }
+
+    if (parser.isSet(corpusOption)) {
+        const QDir corpus(parser.value(corpusOption));
+        QDir().mkpath(corpus.absolutePath());
+        for (const StressCase &stressCase : cases) {
+            if (!writeFile(corpus.filePath(stressCase.name + ".tex"), stressCase.content, err)) {
+                return 1;
+            }
+        }
+        err << "Wrote " << cases.size() << " inputs to " << corpus.absolutePath() << Qt::endl;
+        return 0;
+    }
+
+    Budget budget;
+    budget.timeMs = std::max(1, parser.value(timeOption).toInt());
+    budget.allocatedBytes = static_cast<quint64>(std::max(1, parser.value(memoryOption).toInt())) * 1024 * 1024;
+
+    const QDir output(parser.value(outputOption));
+    if (!QDir().mkpath(output.absolutePath())) {
+        err << "Cannot create " << output.absolutePath() << Qt::endl;
+        return 1;
+    }
+
+    LaTeXErrorChecker checker;
+    LaTeXToHtmlConverter converter;
+
+    QJsonArray results;
+    QStringList recorded;
+    for (const StressCase &stressCase : cases) {
+        const QString path = output.filePath(stressCase.name + ".tex");
+        if (!writeFile(path, stressCase.content, err)) {
+            return 1;
+        }
+
+        bool overBudget = false;
+        QJsonObject stages;
+        stages["check"] = measure(budget, [&]() {
+            return checker.checkDocument(stressCase.content).size();
+        }, overBudget);
+        stages["convert"] = measure(budget, [&]() {
+            return converter.convertToHtml(stressCase.content).size();
+        }, overBudget);
+
+        if (overBudget) {
+            err << "Over budget: " << stressCase.name << Qt::endl;
+            recorded.append(path);
+        } else {
+            QFile::remove(path);
+        }
+
+        QJsonObject result;
+        result["name"] = stressCase.name;
+        result["inputLength"] = static_cast<qint64>(stressCase.content.size());
+        result["stages"] = stages;
+        result["overBudget"] = overBudget;
+        results.append(result);
+    }
+
+    QJsonObject report;
+    report["timeBudgetMs"] = budget.timeMs;
+    report["memoryBudgetBytes"] = static_cast<qint64>(budget.allocatedBytes);
+    report["allocationsIncludeQtContainers"] = AllocationCounter::tracksCAllocations();
+    report["recorded"] = QJsonArray::fromStringList(recorded);
+    report["inputs"] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (parser.isSet(reportOption)) {
+        QFile file(parser.value(reportOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Cannot write " << file.fileName() << ": " << file.errorString() << Qt::endl;
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    err << recorded.size() << " of " << cases.size() << " inputs over budget" << Qt::endl;
+    return recorded.isEmpty() ? 0 : 2;
+}
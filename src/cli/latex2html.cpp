@@ -0,0 +1,143 @@
+// latex2html.cpp
+// Converts .tex files to HTML without starting the editor. Each output is
+// written next to its input with an .html suffix.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QThreadPool>
+#include <QTextStream>
+#include <QtConcurrent>
+#include "../models/ProjectModel.h"
+#include "../utils/LaTeXToHtmlConverter.h"
+
+namespace {
+
+struct ConversionResult {
+    QString inputPath;
+    QString outputPath;
+    qint64 inputBytes = 0;
+    qint64 elapsedMs = 0;
+    QString error;
+};
+
+QString outputPathFor(const QString &inputPath) {
+    const QFileInfo info(inputPath);
+    return info.dir().filePath(info.completeBaseName() + QLatin1String(".html"));
+}
+
+ConversionResult convertFile(const QString &inputPath, bool useCdn) {
+    ConversionResult result;
+    result.inputPath = inputPath;
+    result.outputPath = outputPathFor(inputPath);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile input(inputPath);
+    if (!input.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        result.error = input.errorString();
+        return result;
+    }
+    result.inputBytes = input.size();
+
+    QFile output(result.outputPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        result.error = output.errorString();
+        return result;
+    }
+
+    // One converter per task; the conversion tables themselves are shared
+    LaTeXToHtmlConverter converter;
+    if (!converter.convertToHtml(&input, &output, useCdn)) {
+        result.error = output.errorString();
+    }
+
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("latex2html");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts LaTeX files to HTML next to each input.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "LaTeX files to convert.", "[files...]");
+
+    QCommandLineOption projectOption(QStringList() << "p" << "project",
+                                     "Convert the main file and every file it includes.", "main.tex");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  "Number of files converted at the same time.", "count",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption offlineOption("offline", "Never reference the MathJax CDN in the output.");
+    parser.addOption(projectOption);
+    parser.addOption(jobsOption);
+    parser.addOption(offlineOption);
+    parser.process(app);
+
+    QStringList files;
+    for (const QString &path : parser.positionalArguments()) {
+        files.append(QFileInfo(path).absoluteFilePath());
+    }
+
+    if (parser.isSet(projectOption)) {
+        ProjectModel project;
+        project.setMainFile(QFileInfo(parser.value(projectOption)).absoluteFilePath());
+        for (const QString &path : project.getAllFiles()) {
+            if (!files.contains(path)) {
+                files.append(path);
+            }
+        }
+    }
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (files.isEmpty()) {
+        err << "No input files" << Qt::endl;
+        parser.showHelp(1);
+    }
+
+    bool jobsValid = false;
+    const int jobs = parser.value(jobsOption).toInt(&jobsValid);
+    if (!jobsValid || jobs < 1) {
+        err << "Invalid job count: " << parser.value(jobsOption) << Qt::endl;
+        return 1;
+    }
+
+    // A private pool bounds the number of files open and converted at once
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+
+    const bool useCdn = !parser.isSet(offlineOption);
+    QElapsedTimer total;
+    total.start();
+
+    const QVector<ConversionResult> results = QtConcurrent::blockingMapped<QVector<ConversionResult>>(
+        &pool, files, [useCdn](const QString &path) {
+            return convertFile(path, useCdn);
+        });
+
+    int failures = 0;
+    for (const ConversionResult &result : results) {
+        if (!result.error.isEmpty()) {
+            ++failures;
+            err << result.inputPath << ": " << result.error << Qt::endl;
+            continue;
+        }
+        out << result.inputPath << " -> " << result.outputPath
+            << " (" << result.inputBytes << " bytes, " << result.elapsedMs << " ms)" << Qt::endl;
+    }
+
+    out << results.size() - failures << " of " << results.size() << " files converted in "
+        << total.elapsed() << " ms using " << jobs << " jobs" << Qt::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,429 @@
+// latexlint.cpp
+// Checks .tex files for LaTeX errors without starting the editor, for use in
+// batch pipelines. Errors are written as text, JSON or SARIF. The exit code
+// is 0 if nothing at or above the --fail-on severity was found, 1 if there
+// was and 2 if a file could not be read.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QTextStream>
+#include <QUrl>
+#include <QtConcurrent>
+#include "../models/ProjectModel.h"
+#include "../utils/LaTeXErrorChecker.h"
+#include "../utils/LaTeXProjectLinter.h"
+
+namespace {
+
+struct LintResult {
+    QString path;
+    QVector<LaTeXError> errors;
+    QString readError;
+    bool complete = true;   // false if the limits stopped the check early
+    QVector<LaTeXErrorChecker::RuleStats> ruleStats;
+};
+
+// How every file is checked
+struct LintOptions {
+    LaTeXErrorChecker::Limits limits;
+    QVector<LaTeXErrorChecker::Rule> disabledRules;
+    bool profile = false;
+};
+
+LintResult lintFile(const QString &path, const LintOptions &options) {
+    LintResult result;
+    result.path = path;
+
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        result.readError = input.errorString();
+        return result;
+    }
+
+    // One checker per task; the command table itself is shared
+    LaTeXErrorChecker checker;
+    checker.setLimits(options.limits);
+    for (LaTeXErrorChecker::Rule rule : options.disabledRules) {
+        checker.setRuleEnabled(rule, false);
+    }
+    checker.setProfilingEnabled(options.profile);
+    result.errors = checker.checkDocument(QString::fromUtf8(input.readAll()), &result.complete);
+    if (options.profile) {
+        result.ruleStats = checker.ruleStats();
+    }
+    for (LaTeXError &error : result.errors) {
+        error.file = path;
+    }
+    return result;
+}
+
+// Stable identifiers for the JSON and SARIF output
+QString typeId(LaTeXError::ErrorType type) {
+    switch (type) {
+        case LaTeXError::UnmatchedBrace: return "UnmatchedBrace";
+        case LaTeXError::UnmatchedBracket: return "UnmatchedBracket";
+        case LaTeXError::UnmatchedEnvironment: return "UnmatchedEnvironment";
+        case LaTeXError::UnmatchedMathDelimiter: return "UnmatchedMathDelimiter";
+        case LaTeXError::InvalidCommand: return "InvalidCommand";
+        case LaTeXError::MissingArgument: return "MissingArgument";
+        case LaTeXError::UnknownCommand: return "UnknownCommand";
+        case LaTeXError::MissingPackage: return "MissingPackage";
+        case LaTeXError::UsePackageAfterBeginDocument: return "UsePackageAfterBeginDocument";
+        case LaTeXError::InvalidArgumentCount: return "InvalidArgumentCount";
+        case LaTeXError::DeprecatedCommand: return "DeprecatedCommand";
+        case LaTeXError::MathModeRequired: return "MathModeRequired";
+        case LaTeXError::TextModeRequired: return "TextModeRequired";
+    }
+    return "Unknown";
+}
+
+QString severityId(LaTeXError::Severity severity) {
+    switch (severity) {
+        case LaTeXError::Error: return "error";
+        case LaTeXError::Warning: return "warning";
+        case LaTeXError::Information: return "note";
+    }
+    return "error";
+}
+
+// Inverse of severityId; 'valid' is set to false for unknown names
+LaTeXError::Severity severityFromId(const QString &id, bool *valid) {
+    *valid = true;
+    if (id == "error") {
+        return LaTeXError::Error;
+    }
+    if (id == "warning") {
+        return LaTeXError::Warning;
+    }
+    if (id == "note") {
+        return LaTeXError::Information;
+    }
+    *valid = false;
+    return LaTeXError::Error;
+}
+
+// Lines and columns are 1-based in every format
+QByteArray formatText(const QVector<LaTeXError> &errors) {
+    QByteArray output;
+    for (const LaTeXError &error : errors) {
+        output += QString("%1:%2:%3: %4: %5 [%6]\n")
+                      .arg(error.file)
+                      .arg(error.line + 1)
+                      .arg(error.column + 1)
+                      .arg(severityId(error.severity()), error.message(), typeId(error.type))
+                      .toUtf8();
+    }
+    return output;
+}
+
+QByteArray formatJson(const QVector<LaTeXError> &errors, int fileCount) {
+    QJsonArray items;
+    for (const LaTeXError &error : errors) {
+        QJsonObject item;
+        item["file"] = error.file;
+        item["line"] = error.line + 1;
+        item["column"] = error.column + 1;
+        item["type"] = typeId(error.type);
+        item["severity"] = severityId(error.severity());
+        item["message"] = error.message();
+        items.append(item);
+    }
+
+    QJsonObject root;
+    root["files"] = fileCount;
+    root["errorCount"] = static_cast<int>(errors.size());
+    root["errors"] = items;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+// SARIF 2.1.0, as read by code scanning services
+QByteArray formatSarif(const QVector<LaTeXError> &errors) {
+    QJsonArray rules;
+    for (int type = LaTeXError::UnmatchedBrace; type <= LaTeXError::TextModeRequired; ++type) {
+        QJsonObject rule;
+        rule["id"] = typeId(static_cast<LaTeXError::ErrorType>(type));
+        rules.append(rule);
+    }
+
+    QJsonArray results;
+    for (const LaTeXError &error : errors) {
+        QJsonObject region;
+        region["startLine"] = error.line + 1;
+        region["startColumn"] = error.column + 1;
+
+        QJsonObject artifact;
+        artifact["uri"] = QUrl::fromLocalFile(error.file).toString();
+
+        QJsonObject physicalLocation;
+        physicalLocation["artifactLocation"] = artifact;
+        physicalLocation["region"] = region;
+
+        QJsonObject location;
+        location["physicalLocation"] = physicalLocation;
+
+        QJsonObject message;
+        message["text"] = error.message();
+
+        QJsonObject result;
+        result["ruleId"] = typeId(error.type);
+        result["ruleIndex"] = static_cast<int>(error.type);
+        result["level"] = severityId(error.severity());
+        result["message"] = message;
+        result["locations"] = QJsonArray{location};
+        results.append(result);
+    }
+
+    QJsonObject driver;
+    driver["name"] = QCoreApplication::applicationName();
+    driver["rules"] = rules;
+
+    QJsonObject tool;
+    tool["driver"] = driver;
+
+    QJsonObject run;
+    run["tool"] = tool;
+    run["results"] = results;
+
+    QJsonObject root;
+    root["$schema"] = "https://json.schemastore.org/sarif-2.1.0.json";
+    root["version"] = "2.1.0";
+    root["runs"] = QJsonArray{run};
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("latexlint");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks LaTeX files for errors. Exits with 1 if errors were found, "
+                                     "or warnings and notes as set by --fail-on, and with 2 if a file "
+                                     "could not be read.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "LaTeX files, or directories searched for .tex files.", "[files...]");
+
+    QCommandLineOption projectOption(QStringList() << "p" << "project",
+                                     "Check the main file and every file it includes, carrying the "
+                                     "document state across includes.", "main.tex");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  "Number of files checked at the same time.", "count",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+                                    "Output format: text, json or sarif.", "format", "text");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Write the report to a file instead of standard output.", "file");
+    QCommandLineOption maxErrorsOption(QStringList() << "max-errors",
+                                       "Stop checking a file after this many errors, 0 for no limit. "
+                                       "Not available with --project.",
+                                       "count", "0");
+    QCommandLineOption timeBudgetOption(QStringList() << "time-budget",
+                                        "Stop checking a file after this many milliseconds, 0 for no limit. "
+                                        "Not available with --project.",
+                                        "ms", "0");
+    QCommandLineOption disableRulesOption(QStringList() << "disable-rules",
+                                          "Comma-separated rules not to check, such as bare-math,multiple-spaces.",
+                                          "rules");
+    QCommandLineOption profileOption(QStringList() << "profile",
+                                     "Write the time and error count of every rule to standard error. "
+                                     "Not available with --project.");
+    parser.addOption(projectOption);
+    parser.addOption(jobsOption);
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(maxErrorsOption);
+    parser.addOption(timeBudgetOption);
+    parser.addOption(disableRulesOption);
+    QCommandLineOption failOnOption(QStringList() << "fail-on",
+                                    "Lowest severity that makes the exit code 1: error, warning or note.",
+                                    "severity", "error");
+    parser.addOption(profileOption);
+    parser.addOption(failOnOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    QStringList files;
+    for (const QString &argument : parser.positionalArguments()) {
+        const QFileInfo info(argument);
+        if (!info.isDir()) {
+            files.append(info.absoluteFilePath());
+            continue;
+        }
+        QStringList found;
+        QDirIterator it(info.absoluteFilePath(), QStringList() << "*.tex", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            found.append(it.next());
+        }
+        found.sort();
+        files += found;
+    }
+    files.removeDuplicates();
+
+    const QString format = parser.value(formatOption);
+    if (format != "text" && format != "json" && format != "sarif") {
+        err << "Invalid format: " << format << Qt::endl;
+        return 2;
+    }
+
+    if (files.isEmpty() && !parser.isSet(projectOption)) {
+        err << "No input files" << Qt::endl;
+        parser.showHelp(2);
+    }
+
+    bool failOnValid = false;
+    const LaTeXError::Severity failOn = severityFromId(parser.value(failOnOption), &failOnValid);
+    if (!failOnValid) {
+        err << "Invalid severity: " << parser.value(failOnOption) << Qt::endl;
+        return 2;
+    }
+
+    bool jobsValid = false;
+    const int jobs = parser.value(jobsOption).toInt(&jobsValid);
+    if (!jobsValid || jobs < 1) {
+        err << "Invalid job count: " << parser.value(jobsOption) << Qt::endl;
+        return 2;
+    }
+
+    // Bounds the time and output per file on generated or pathological input
+    LintOptions options;
+    bool maxErrorsValid = false;
+    bool timeBudgetValid = false;
+    options.limits.maxErrors = parser.value(maxErrorsOption).toInt(&maxErrorsValid);
+    options.limits.timeBudgetMs = parser.value(timeBudgetOption).toInt(&timeBudgetValid);
+    if (!maxErrorsValid || !timeBudgetValid || options.limits.maxErrors < 0 || options.limits.timeBudgetMs < 0) {
+        err << "Invalid limit" << Qt::endl;
+        return 2;
+    }
+
+    for (const QString &name : parser.value(disableRulesOption).split(',', Qt::SkipEmptyParts)) {
+        const LaTeXErrorChecker::Rule rule = LaTeXErrorChecker::ruleFromName(name.trimmed());
+        if (rule == LaTeXErrorChecker::RuleCount) {
+            err << "Unknown rule: " << name << Qt::endl;
+            return 2;
+        }
+        options.disabledRules.append(rule);
+    }
+    options.profile = parser.isSet(profileOption);
+
+    // The project linter shares one checker between threads and caches whole
+    // files, so it can neither stop a file early nor profile it
+    if (parser.isSet(projectOption)
+        && (options.limits.maxErrors > 0 || options.limits.timeBudgetMs > 0 || options.profile)) {
+        err << "--max-errors, --time-budget and --profile cannot be used with --project" << Qt::endl;
+        return 2;
+    }
+
+    // A private pool bounds the number of files open and checked at once
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+
+    QElapsedTimer total;
+    total.start();
+
+    QVector<LaTeXError> errors;
+    int fileCount = 0;
+    int failures = 0;
+
+    if (parser.isSet(projectOption)) {
+        const QString mainFile = QFileInfo(parser.value(projectOption)).absoluteFilePath();
+        if (!QFileInfo::exists(mainFile)) {
+            err << mainFile << ": No such file" << Qt::endl;
+            return 2;
+        }
+        ProjectModel project;
+        project.setMainFile(mainFile);
+
+        LaTeXProjectLinter linter;
+        const LaTeXProjectLinter::Result result =
+            linter.lint(mainFile, LaTeXProjectLinter::includeMap(project), &pool);
+        // The linter checks with every rule; only hide the switched off ones
+        for (const LaTeXError &error : result.errors) {
+            if (!options.disabledRules.contains(LaTeXErrorChecker::ruleOf(error.messageId))) {
+                errors.append(error);
+            }
+        }
+        fileCount = static_cast<int>(result.files.size());
+
+        // Files named on the command line are checked on their own as well
+        for (const QString &path : result.files) {
+            files.removeAll(path);
+        }
+    }
+
+    const QVector<LintResult> results = QtConcurrent::blockingMapped<QVector<LintResult>>(
+        &pool, files, [&options](const QString &path) {
+            return lintFile(path, options);
+        });
+    QVector<LaTeXErrorChecker::RuleStats> ruleStats(LaTeXErrorChecker::RuleCount);
+    for (const LintResult &result : results) {
+        if (!result.readError.isEmpty()) {
+            ++failures;
+            err << result.path << ": " << result.readError << Qt::endl;
+            continue;
+        }
+        ++fileCount;
+        errors += result.errors;
+        if (!result.complete) {
+            err << result.path << ": Stopped early, only the first errors are reported" << Qt::endl;
+        }
+        for (int rule = 0; rule < result.ruleStats.size(); ++rule) {
+            ruleStats[rule].runs += result.ruleStats[rule].runs;
+            ruleStats[rule].hits += result.ruleStats[rule].hits;
+            ruleStats[rule].nanoseconds += result.ruleStats[rule].nanoseconds;
+        }
+    }
+
+    QByteArray report;
+    if (format == "json") {
+        report = formatJson(errors, fileCount);
+    } else if (format == "sarif") {
+        report = formatSarif(errors);
+    } else {
+        report = formatText(errors);
+    }
+
+    if (parser.isSet(outputOption)) {
+        QSaveFile output(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly) || output.write(report) != report.size() || !output.commit()) {
+            err << parser.value(outputOption) << ": " << output.errorString() << Qt::endl;
+            return 2;
+        }
+    } else {
+        QFile output;
+        if (!output.open(stdout, QIODevice::WriteOnly)) {
+            return 2;
+        }
+        output.write(report);
+    }
+
+    if (options.profile) {
+        err << LaTeXErrorChecker::ruleStatsReport(ruleStats);
+    }
+
+    // The summary goes to stderr so the report can be piped
+    err << errors.size() << " error(s) in " << fileCount << " file(s), checked in "
+        << total.elapsed() << " ms using " << jobs << " jobs" << Qt::endl;
+
+    if (failures > 0) {
+        return 2;
+    }
+    // Severities are ordered from Error to Information
+    for (const LaTeXError &error : std::as_const(errors)) {
+        if (error.severity() <= failOn) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,12 +1,18 @@
 #include "PreviewController.h"
 #include <QDebug>
-#include <QRegularExpression>
 
 PreviewController::PreviewController(DocumentModel *model, PreviewWindow *view, QObject *parent)
-        : QObject(parent), m_model(model), m_view(view) {
-
-    // Initialize converter
-    m_converter = new LaTeXToHtmlConverter();
+        : QObject(parent), m_model(model), m_view(view), m_generation(0) {
+
+    // Conversion runs on a worker thread so typing never waits for the preview
+    m_renderer = new PreviewRenderer();
+    m_renderer->moveToThread(&m_renderThread);
+    connect(&m_renderThread, &QThread::finished, m_renderer, &QObject::deleteLater);
+    connect(this, &PreviewController::renderRequested, m_renderer, &PreviewRenderer::render,
+            Qt::QueuedConnection);
+    connect(m_renderer, &PreviewRenderer::renderFinished, this, &PreviewController::onRenderFinished,
+            Qt::QueuedConnection);
+    m_renderThread.start();
 
     // Create timer for debounced updates
     m_updateTimer = new QTimer(this);
@@ -21,12 +27,21 @@ PreviewController::PreviewController(DocumentModel *model, PreviewWindow *view,
     updatePreview();
 }
 
+PreviewController::~PreviewController() {
+    // Abandon the running job, then let the thread's event loop delete the renderer
+    m_renderThread.requestInterruption();
+    m_renderThread.quit();
+    m_renderThread.wait();
+}
+
 void PreviewController::updatePreview(const QString &content) {
-    qDebug() << "PreviewController::updatePreview called";
     QString latexContent = content.isEmpty() ? m_model->getContent() : content;
-    QString htmlContent = generatePreviewContent(latexContent);
-    m_view->updatePreview(htmlContent);
-    qDebug() << "Preview updated";
+
+    // Any conversion still running for an older snapshot is cancelled
+    ++m_generation;
+    m_renderer->setLatestGeneration(m_generation);
+    emit renderRequested(m_generation, latexContent);
+    qDebug() << "Preview generation" << m_generation << "requested";
 }
 
 void PreviewController::schedulePreviewUpdate() {
@@ -34,7 +49,12 @@ void PreviewController::schedulePreviewUpdate() {
     m_updateTimer->start();
 }
 
-QString PreviewController::generatePreviewContent(const QString &latexContent) {
-    // Use the enhanced converter (with CDN for MathJax)
-    return m_converter->convertToHtml(latexContent, true);
-}
\ No newline at end of file
+void PreviewController::onRenderFinished(quint64 generation, const QString &documentShell,
+                                         const QStringList &blockKeys, const QStringList &blockHtml) {
+    // A newer snapshot was requested after this one finished; its result follows
+    if (generation != m_generation) {
+        return;
+    }
+    m_view->updatePreview(documentShell, blockKeys, blockHtml);
+    qDebug() << "Preview updated";
+}
@@ -3,28 +3,39 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QThread>
 #include "../models/DocumentModel.h"
 #include "../views/PreviewWindow.h"
-#include "../utils/LaTeXToHtmlConverter.h"
+#include "../utils/PreviewRenderer.h"
 
 class PreviewController : public QObject {
 Q_OBJECT
 
 public:
     explicit PreviewController(DocumentModel *model, PreviewWindow *view, QObject *parent = nullptr);
+    ~PreviewController();
 
 public slots:
 
     void updatePreview(const QString &content = QString());
     void schedulePreviewUpdate();
 
-private:
-    QString generatePreviewContent(const QString &latexContent);
+signals:
+    void renderRequested(quint64 generation, const QString &latexContent);
+
+private slots:
+    void onRenderFinished(quint64 generation, const QString &documentShell,
+                          const QStringList &blockKeys, const QStringList &blockHtml);
 
+private:
     DocumentModel *m_model;
     PreviewWindow *m_view;
     QTimer *m_updateTimer;
-    LaTeXToHtmlConverter *m_converter;
+
+    // Conversion runs on m_renderThread; m_renderer lives there
+    QThread m_renderThread;
+    PreviewRenderer *m_renderer;
+    quint64 m_generation;
 };
 
 #endif // PREVIEWCONTROLLER_H
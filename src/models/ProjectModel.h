@@ -64,7 +64,6 @@ private:
     // Helper methods
     void addFileToProject(const QString &filePath, bool isMain = false);
     QStringList parseIncludesFromFile(const QString &filePath) const;
-    QString resolveIncludePath(const QString &basePath, const QString &includePath) const;
 };
 
 #endif // PROJECTMODEL_H
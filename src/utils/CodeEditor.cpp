@@ -4,14 +4,29 @@
 #include <QTextBlock>
 #include <QContextMenuEvent>
 #include <QTextCursor>
+#include <algorithm>
+#include <numeric>
 
-CodeEditor::CodeEditor(QWidget *parent) : QPlainTextEdit(parent), m_spellChecker(nullptr) {
+namespace {
+
+QColor severityColor(LaTeXError::Severity severity) {
+    switch (severity) {
+        case LaTeXError::Error: return Qt::red;
+        case LaTeXError::Warning: return QColor(255, 140, 0);
+        case LaTeXError::Information: return Qt::blue;
+    }
+    return Qt::red;
+}
+
+} // namespace
+
+CodeEditor::CodeEditor(QWidget *parent)
+    : QPlainTextEdit(parent), m_decoratedFirstLine(-1), m_decoratedLastLine(-1), m_spellChecker(nullptr) {
     lineNumberArea = new LineNumberArea(this);
 
     connect(this, &CodeEditor::blockCountChanged, this, &CodeEditor::updateLineNumberAreaWidth);
     connect(this, &CodeEditor::updateRequest, this, &CodeEditor::updateLineNumberArea);
     connect(this, &CodeEditor::cursorPositionChanged, this, &CodeEditor::highlightCurrentLine);
-    connect(this, &CodeEditor::cursorPositionChanged, this, &CodeEditor::highlightErrors);
 
     updateLineNumberAreaWidth(0);
     highlightCurrentLine();
@@ -42,6 +57,13 @@ void CodeEditor::updateLineNumberArea(const QRect &rect, int dy) {
 
     if (rect.contains(viewport()->rect()))
         updateLineNumberAreaWidth(0);
+
+    // Scrolling, resizing or editing may bring other lines into view
+    if (!m_errorsByLine.isEmpty()
+        && (firstVisibleBlock().blockNumber() != m_decoratedFirstLine || lastVisibleLine() != m_decoratedLastLine)) {
+        updateErrorSelections();
+        highlightCurrentLine();
+    }
 }
 
 void CodeEditor::resizeEvent(QResizeEvent *e) {
@@ -66,47 +88,81 @@ void CodeEditor::highlightCurrentLine() {
         extraSelections.append(selection);
     }
 
-    // Add error highlights
-    for (const LaTeXError &error : m_errors) {
-        QTextBlock block = document()->findBlockByLineNumber(error.line);
-        if (block.isValid()) {
-            QTextEdit::ExtraSelection selection;
-            selection.format.setUnderlineColor(Qt::red);
-            selection.format.setUnderlineStyle(QTextCharFormat::WaveUnderline);
+    // Error underlines are only rebuilt when the errors or the visible lines change
+    extraSelections += m_errorSelections;
 
-            selection.cursor = QTextCursor(block);
-            selection.cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, error.column);
+    setExtraSelections(extraSelections);
+}
 
-            // Underline the problematic area (or whole line if column is 0)
-            if (error.column == 0) {
-                selection.cursor.select(QTextCursor::LineUnderCursor);
-            } else {
-                // Underline a few characters or until end of word
-                int endPos = error.column + qMax(1, error.context.length());
-                selection.cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor,
-                                             qMin(endPos - error.column, block.length() - error.column));
-            }
+QVector<int>::const_iterator CodeEditor::firstErrorFrom(int line) const {
+    return std::lower_bound(m_errorsByLine.cbegin(), m_errorsByLine.cend(), line,
+                            [this](int index, int value) { return m_errors[index].line < value; });
+}
+
+void CodeEditor::indexErrors() {
+    m_errorsByLine.resize(m_errors.size());
+    std::iota(m_errorsByLine.begin(), m_errorsByLine.end(), 0);
+    std::stable_sort(m_errorsByLine.begin(), m_errorsByLine.end(),
+                     [this](int a, int b) { return m_errors[a].line < m_errors[b].line; });
+}
+
+void CodeEditor::updateErrorSelections() {
+    m_errorSelections.clear();
 
-            extraSelections.append(selection);
+    QTextBlock block = firstVisibleBlock();
+    int blockNumber = block.blockNumber();
+    m_decoratedFirstLine = blockNumber;
+    m_decoratedLastLine = lastVisibleLine();
+
+    for (auto it = firstErrorFrom(blockNumber); it != m_errorsByLine.cend(); ++it) {
+        const LaTeXError &error = m_errors[*it];
+        if (error.line > m_decoratedLastLine) {
+            break;
+        }
+        while (block.isValid() && blockNumber < error.line) {
+            block = block.next();
+            ++blockNumber;
+        }
+        if (!block.isValid()) {
+            break;
         }
-    }
 
-    setExtraSelections(extraSelections);
+        QTextEdit::ExtraSelection selection;
+        selection.format.setUnderlineColor(severityColor(error.severity()));
+        selection.format.setUnderlineStyle(QTextCharFormat::WaveUnderline);
+
+        // Underline the problematic area (or whole line if column is 0)
+        const int column = qMin(error.column, block.length() - 1);
+        selection.cursor = QTextCursor(block);
+        selection.cursor.setPosition(block.position() + column);
+        if (column == 0) {
+            selection.cursor.select(QTextCursor::LineUnderCursor);
+        } else {
+            const int length = qMin(qMax(1, error.length), block.length() - column);
+            selection.cursor.setPosition(block.position() + column + length, QTextCursor::KeepAnchor);
+        }
+
+        m_errorSelections.append(selection);
+    }
 }
 
-void CodeEditor::highlightErrors() {
-    highlightCurrentLine(); // Re-apply both highlights
+int CodeEditor::lastVisibleLine() const {
+    return cursorForPosition(QPoint(0, viewport()->height() - 1)).blockNumber();
 }
 
 void CodeEditor::setErrors(const QVector<LaTeXError> &errors) {
     m_errors = errors;
-    highlightErrors();
+    indexErrors();
+    updateErrorSelections();
+    highlightCurrentLine();
     lineNumberArea->update(); // Update to show error icons
 }
 
 void CodeEditor::clearErrors() {
     m_errors.clear();
-    highlightErrors();
+    m_errorsByLine.clear();
+    m_errorSelections.clear();
+    highlightCurrentLine();
     lineNumberArea->update();
 }
 
@@ -190,22 +246,25 @@ void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event) {
     int blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
     int bottom = top + qRound(blockBoundingRect(block).height());
+    auto error = firstErrorFrom(blockNumber);
 
     while (block.isValid() && top <= event->rect().bottom()) {
         if (block.isVisible() && bottom >= event->rect().top()) {
             QString number = QString::number(blockNumber + 1);
 
-            // Check if this line has errors
+            // Check if this line has errors; the marker shows the most severe
             bool hasError = false;
-            for (const LaTeXError &error : m_errors) {
-                if (error.line == blockNumber) {
-                    hasError = true;
-                    break;
-                }
+            LaTeXError::Severity severity = LaTeXError::Information;
+            while (error != m_errorsByLine.cend() && m_errors[*error].line < blockNumber) {
+                ++error;
+            }
+            for (; error != m_errorsByLine.cend() && m_errors[*error].line == blockNumber; ++error) {
+                hasError = true;
+                severity = qMin(severity, m_errors[*error].severity());
             }
 
             if (hasError) {
-                painter.setPen(Qt::red);
+                painter.setPen(severityColor(severity));
                 painter.setFont(QFont(painter.font().family(), painter.font().pointSize(), QFont::Bold));
                 // Draw error indicator
                 painter.drawText(0, top, 16, fontMetrics().height(), Qt::AlignLeft, "!");
@@ -26,7 +26,8 @@ public:
 
     void setErrors(const QVector<LaTeXError> &errors);
     void clearErrors();
-    QVector<LaTeXError> getErrors() const { return m_errors; }
+    const QVector<LaTeXError> &getErrors() const { return m_errors; }
+    int lastVisibleLine() const;
 
     void setSpellChecker(SpellChecker *spellChecker);
 
@@ -38,11 +39,20 @@ private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(const QRect &rect, int dy);
-    void highlightErrors();
 
 private:
+    // First entry of m_errorsByLine on 'line' or after it
+    QVector<int>::const_iterator firstErrorFrom(int line) const;
+    void indexErrors();
+    // Builds the underlines for the errors on the visible blocks only
+    void updateErrorSelections();
+
     QWidget *lineNumberArea;
     QVector<LaTeXError> m_errors;
+    QVector<int> m_errorsByLine;   // Indexes into m_errors, by line; rebuilt when the errors change
+    QList<QTextEdit::ExtraSelection> m_errorSelections;
+    int m_decoratedFirstLine;      // Visible lines m_errorSelections was built for
+    int m_decoratedLastLine;
     SpellChecker *m_spellChecker;
 
     QString getWordUnderCursor() const;
@@ -0,0 +1,103 @@
+// ErrorCheckWorker.cpp
+#include "ErrorCheckWorker.h"
+#include "PerformanceMonitor.h"
+#include <QThread>
+#include <QDebug>
+
+namespace {
+
+// Longest a slice of a check runs before its results are published
+const int SliceBudgetMs = 100;
+// More errors than this are not useful in the editor and slow down highlighting
+const int MaxErrors = 2000;
+
+} // namespace
+
+ErrorCheckWorker::ErrorCheckWorker(QObject *parent)
+    : QObject(parent)
+    , m_latestVersion(0)
+    , m_checker(nullptr)
+    , m_ruleProfiling(false)
+{
+}
+
+void ErrorCheckWorker::setLatestVersion(quint64 version) {
+    m_latestVersion.store(version);
+}
+
+bool ErrorCheckWorker::isStale(quint64 version) const {
+    return version != m_latestVersion.load()
+        || QThread::currentThread()->isInterruptionRequested();
+}
+
+void ErrorCheckWorker::check(quint64 version, const QString &content, int lastVisibleLine) {
+    // Snapshots queue up while a check runs; skip the ones already superseded
+    if (isStale(version)) {
+        return;
+    }
+
+    // Created here, on the worker thread, so loading the command database
+    // does not delay the editor's startup
+    if (!m_checker) {
+        m_checker = new LaTeXErrorChecker(this);
+        LaTeXErrorChecker::Limits limits;
+        limits.timeBudgetMs = SliceBudgetMs;
+        limits.maxErrors = MaxErrors;
+        m_checker->setLimits(limits);
+        applyRuleSettings();
+    }
+
+    // Rule timings reach the performance panel whenever it records
+    m_checker->setProfilingEnabled(m_ruleProfiling || PerformanceMonitor::getInstance().isEnabled());
+
+    int pauseAfterLine = lastVisibleLine;
+    while (true) {
+        QVector<LaTeXError> errors;
+        const LaTeXErrorChecker::CheckStatus status = m_checker->checkIncremental(
+            content, errors, [this, version]() { return isStale(version); }, pauseAfterLine);
+
+        switch (status) {
+            case LaTeXErrorChecker::CheckStatus::Cancelled:
+                qDebug() << "Error check version" << version << "cancelled";
+                return;
+            case LaTeXErrorChecker::CheckStatus::Complete:
+                emit checkFinished(version, errors);
+                return;
+            case LaTeXErrorChecker::CheckStatus::Paused:
+                emit checkProgress(version, errors);
+                break;
+        }
+
+        // A newer snapshot continues from where this check paused
+        if (isStale(version)) {
+            return;
+        }
+        pauseAfterLine = -1;
+    }
+}
+
+void ErrorCheckWorker::setDisabledRules(const QStringList &rules) {
+    m_disabledRules = rules;
+    applyRuleSettings();
+}
+
+void ErrorCheckWorker::setRuleProfilingEnabled(bool enabled) {
+    if (m_checker && m_ruleProfiling && !enabled) {
+        qDebug().noquote() << "Error check rules:\n"
+                           << LaTeXErrorChecker::ruleStatsReport(m_checker->ruleStats());
+        m_checker->resetRuleStats();
+    }
+    m_ruleProfiling = enabled;
+    applyRuleSettings();
+}
+
+void ErrorCheckWorker::applyRuleSettings() {
+    if (!m_checker) {
+        return;
+    }
+    for (int rule = 0; rule < LaTeXErrorChecker::RuleCount; ++rule) {
+        const LaTeXErrorChecker::Rule id = static_cast<LaTeXErrorChecker::Rule>(rule);
+        m_checker->setRuleEnabled(id, !m_disabledRules.contains(LaTeXErrorChecker::ruleName(id)));
+    }
+    m_checker->setProfilingEnabled(m_ruleProfiling || PerformanceMonitor::getInstance().isEnabled());
+}
@@ -0,0 +1,52 @@
+// ErrorCheckWorker.h
+#ifndef ERRORCHECKWORKER_H
+#define ERRORCHECKWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include "LaTeXErrorChecker.h"
+
+// Checks document snapshots on a worker thread. Every snapshot carries a
+// version number; a check is abandoned as soon as a newer version has been
+// requested, so only the newest result is ever delivered.
+//
+// Checks run in slices of a fixed time budget. The first slice stops once
+// the lines on screen are checked, so their results show without waiting
+// for the rest of a long document, which then streams in slice by slice.
+class ErrorCheckWorker : public QObject {
+Q_OBJECT
+
+public:
+    explicit ErrorCheckWorker(QObject *parent = nullptr);
+
+    // Thread-safe: marks every check older than 'version' as stale
+    void setLatestVersion(quint64 version);
+
+public slots:
+    // 'lastVisibleLine' is the last line on screen, or -1 if not known
+    void check(quint64 version, const QString &content, int lastVisibleLine);
+    // Rules by LaTeXErrorChecker::ruleName; the next check applies them
+    void setDisabledRules(const QStringList &rules);
+    // Rules are also profiled while the performance panel records timings.
+    // Turning profiling off writes the collected rule stats to the debug log
+    void setRuleProfilingEnabled(bool enabled);
+
+signals:
+    // Errors on the lines checked so far; more results for 'version' follow
+    void checkProgress(quint64 version, const QVector<LaTeXError> &errors);
+    void checkFinished(quint64 version, const QVector<LaTeXError> &errors);
+
+private:
+    bool isStale(quint64 version) const;
+    void applyRuleSettings();
+
+    std::atomic<quint64> m_latestVersion;
+    LaTeXErrorChecker *m_checker;
+    QStringList m_disabledRules;
+    bool m_ruleProfiling;
+};
+
+#endif // ERRORCHECKWORKER_H
@@ -0,0 +1,117 @@
+// LaTeXBlockCache.cpp
+#include "LaTeXBlockCache.h"
+#include "LaTeXBlockSplitter.h"
+#include "LaTeXToHtmlConverter.h"
+#include "PerformanceMonitor.h"
+
+LaTeXBlockCache::LaTeXBlockCache(const LaTeXToHtmlConverter &converter)
+    : m_converter(converter)
+    , m_lastConverted(0)
+    , m_lastReused(0)
+{
+}
+
+size_t LaTeXBlockCache::blockKey(QStringView source) {
+    return qHash(source);
+}
+
+const LaTeXBlockCache::CachedBlock *LaTeXBlockCache::find(const QHash<size_t, CachedBlock> &cache, size_t key,
+                                                          QStringView source) {
+    const auto it = cache.constFind(key);
+    return it != cache.constEnd() && QStringView(it.value().source) == source ? &it.value() : nullptr;
+}
+
+bool LaTeXBlockCache::convertBlocks(const QString &latexContent, QVector<HtmlBlock> &blocks,
+                                    const std::function<bool()> &isCancelled) {
+    QVector<LaTeXBlockSplitter::Block> sourceBlocks;
+    {
+        ScopedTimer timer("Preview: split blocks");
+        sourceBlocks = LaTeXBlockSplitter::split(latexContent);
+    }
+    ScopedTimer timer("Preview: convert blocks");
+
+    blocks.clear();
+    blocks.reserve(sourceBlocks.size());
+
+    // Entries for blocks that no longer exist are dropped by rebuilding the cache
+    QHash<size_t, CachedBlock> cache;
+    cache.reserve(sourceBlocks.size());
+    m_lastConverted = 0;
+    m_lastReused = 0;
+
+    const qsizetype blockCount = sourceBlocks.size();
+    qsizetype first = 0;
+    while (first < blockCount) {
+        // A block that is not self-contained is retried together with the
+        // blocks after it, doubling their number each time, so a group left
+        // open early in the document costs a few conversions of the rest of
+        // the document rather than one per block
+        qsizetype count = 1;
+        while (true) {
+            const qsizetype last = qMin(first + count, blockCount) - 1;
+            const qsizetype start = sourceBlocks[first].start;
+            const qsizetype end = sourceBlocks[last].start + sourceBlocks[last].length;
+            const QStringView source = QStringView(latexContent).mid(start, end - start);
+            const size_t key = blockKey(source);
+            const bool atEnd = last == blockCount - 1;
+
+            // Blocks known not to be self-contained are cached too, so the
+            // next run goes straight to the merged block
+            CachedBlock block;
+            if (const CachedBlock *cached = find(m_cache, key, source)) {
+                block = *cached;
+                ++m_lastReused;
+            } else if (const CachedBlock *converted = find(cache, key, source)) {
+                block = *converted;
+                ++m_lastReused;
+            } else {
+                if (isCancelled && isCancelled()) {
+                    // Keep what was converted so far for the next run
+                    for (auto it = cache.constBegin(); it != cache.constEnd(); ++it) {
+                        m_cache.insert(it.key(), it.value());
+                    }
+                    return false;
+                }
+                block.source = source.toString();
+                block.selfContained = m_converter.convertBlock(source, block.html);
+                ++m_lastConverted;
+            }
+
+            // On a hash collision the block seen last wins the entry
+            cache.insert(key, block);
+            if (block.selfContained || atEnd) {
+                blocks.append(HtmlBlock{key, block.html});
+                first = last + 1;
+                break;
+            }
+            count *= 2;
+        }
+    }
+
+    m_cache.swap(cache);
+    return true;
+}
+
+bool LaTeXBlockCache::convertBody(const QString &latexContent, QString &body,
+                                  const std::function<bool()> &isCancelled) {
+    QVector<HtmlBlock> blocks;
+    if (!convertBlocks(latexContent, blocks, isCancelled)) {
+        return false;
+    }
+
+    qsizetype size = 0;
+    for (const HtmlBlock &block : blocks) {
+        size += block.html.size();
+    }
+
+    body.clear();
+    body.reserve(size);
+    for (const HtmlBlock &block : blocks) {
+        body += block.html;
+    }
+    return true;
+}
+
+void LaTeXBlockCache::clear() {
+    m_cache.clear();
+}
@@ -0,0 +1,59 @@
+// LaTeXBlockCache.h
+#ifndef LATEXBLOCKCACHE_H
+#define LATEXBLOCKCACHE_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <QHash>
+#include <functional>
+
+class LaTeXToHtmlConverter;
+
+// Converted HTML for one top-level block of the source
+struct HtmlBlock {
+    size_t key;     // Content hash of the block's LaTeX source
+    QString html;
+};
+
+// Converts documents block by block and remembers the HTML of each block,
+// looked up by a hash of its source and checked against the source itself. Only blocks that changed since the last
+// call are converted again. A block that depends on the text after it is
+// merged with the following blocks, so the concatenated HTML always equals
+// LaTeXToHtmlConverter::convertBody of the whole document.
+class LaTeXBlockCache {
+public:
+    explicit LaTeXBlockCache(const LaTeXToHtmlConverter &converter);
+
+    // Both return false, leaving the output incomplete, once isCancelled reports true.
+    // Blocks converted before the cancellation are kept in the cache.
+    bool convertBlocks(const QString &latexContent, QVector<HtmlBlock> &blocks,
+                       const std::function<bool()> &isCancelled = std::function<bool()>());
+    bool convertBody(const QString &latexContent, QString &body,
+                     const std::function<bool()> &isCancelled = std::function<bool()>());
+    void clear();
+
+    // Statistics for the last conversion
+    int lastConvertedCount() const { return m_lastConverted; }
+    int lastReusedCount() const { return m_lastReused; }
+
+    static size_t blockKey(QStringView source);
+
+private:
+    struct CachedBlock {
+        QString source;     // Compared on every hit, since different sources may share a hash
+        QString html;
+        // False if the source only converts like this at the end of the
+        // document, because it leaves a group or argument open
+        bool selfContained = true;
+    };
+
+    static const CachedBlock *find(const QHash<size_t, CachedBlock> &cache, size_t key, QStringView source);
+
+    const LaTeXToHtmlConverter &m_converter;
+    QHash<size_t, CachedBlock> m_cache;
+    int m_lastConverted;
+    int m_lastReused;
+};
+
+#endif // LATEXBLOCKCACHE_H
@@ -0,0 +1,210 @@
+// LaTeXBlockSplitter.cpp
+#include "LaTeXBlockSplitter.h"
+#include "LaTeXLineIndex.h"
+
+QVector<LaTeXBlockSplitter::Block> LaTeXBlockSplitter::split(QStringView source) {
+    QVector<Block> blocks;
+    LaTeXBlockSplitter splitter;
+
+    // Line and comment boundaries come from one vectorized scan
+    const LaTeXLineIndex index(source);
+    const qsizetype size = source.size();
+    qsizetype blockStart = 0;
+
+    for (int line = 0; line < index.lineCount(); ++line) {
+        const qsizetype lineStart = index.lineStart(line);
+        if (lineStart >= size) {
+            break;
+        }
+        if (splitter.startsBlock(index.line(line), index.commentColumn(line)) && lineStart > blockStart) {
+            blocks.append(Block{blockStart, lineStart - blockStart});
+            blockStart = lineStart;
+        }
+    }
+
+    if (size > blockStart) {
+        blocks.append(Block{blockStart, size - blockStart});
+    }
+    return blocks;
+}
+
+void LaTeXBlockSplitter::reset() {
+    m_depth = 0;
+    m_headingBraces = 0;
+    m_pendingBreak = false;
+    m_firstLine = true;
+    m_verbatimEnd.clear();
+}
+
+bool LaTeXBlockSplitter::startsBlock(QStringView line) {
+    return startsBlock(line, commentStart(line));
+}
+
+bool LaTeXBlockSplitter::startsBlock(QStringView line, qsizetype commentColumn) {
+    const bool firstLine = m_firstLine;
+    m_firstLine = false;
+
+    // Nothing inside a verbatim environment is interpreted until its end marker
+    qsizetype pos = 0;
+    if (!m_verbatimEnd.isEmpty()) {
+        const qsizetype endPos = line.indexOf(m_verbatimEnd);
+        if (endPos < 0) {
+            return false;
+        }
+        pos = endPos + m_verbatimEnd.size();
+        m_verbatimEnd.clear();
+        if (--m_depth <= 0) {
+            m_depth = 0;
+            m_pendingBreak = true;
+        }
+    }
+
+    const QStringView code = commentColumn < 0 ? line : line.left(commentColumn);
+
+    // A heading whose argument spans lines ends where the argument closes
+    if (m_headingBraces > 0) {
+        m_headingBraces += braceBalance(code);
+        if (m_headingBraces <= 0) {
+            m_headingBraces = 0;
+            m_pendingBreak = true;
+        }
+        return false;
+    }
+
+    const QStringView trimmed = code.mid(pos).trimmed();
+
+    if (m_depth == 0 && trimmed.isEmpty()) {
+        // A blank line ends the paragraph but stays attached to the block before it.
+        // Comment-only lines are not paragraph breaks.
+        if (pos == 0 && line.trimmed().isEmpty()) {
+            m_pendingBreak = true;
+        }
+        return false;
+    }
+
+    bool starts = m_pendingBreak;
+    m_pendingBreak = false;
+
+    if (m_depth == 0 && pos == 0) {
+        if (isSectioningLine(trimmed)) {
+            starts = true;
+            m_headingBraces = braceBalance(code);
+            if (m_headingBraces > 0) {
+                return starts && !firstLine;
+            }
+            m_headingBraces = 0;
+            m_pendingBreak = true;
+        } else if (trimmed.startsWith(u"\\begin{") || trimmed.startsWith(u"\\end{document}")) {
+            starts = true;
+        }
+    }
+
+    // Track environment nesting for the rest of the line
+    while ((pos = code.indexOf(u'\\', pos)) >= 0) {
+        const QStringView rest = code.mid(pos);
+        const bool isBegin = rest.startsWith(u"\\begin{");
+        const bool isEnd = !isBegin && rest.startsWith(u"\\end{");
+        if (!isBegin && !isEnd) {
+            pos += 2; // Skip control symbols such as \\ and \%
+            continue;
+        }
+
+        const qsizetype nameStart = isBegin ? 7 : 5;
+        const qsizetype close = rest.indexOf(u'}', nameStart);
+        if (close < 0) {
+            break;
+        }
+        const QStringView name = rest.mid(nameStart, close - nameStart);
+        pos += close + 1;
+
+        if (name == u"document") {
+            m_pendingBreak = true;
+            continue;
+        }
+
+        if (isEnd) {
+            if (m_depth > 0 && --m_depth == 0) {
+                m_pendingBreak = true;
+            }
+            continue;
+        }
+
+        ++m_depth;
+        if (isVerbatimEnvironment(name)) {
+            m_verbatimEnd = QLatin1String("\\end{");
+            m_verbatimEnd += name;
+            m_verbatimEnd += QLatin1Char('}');
+
+            // The environment may also close on the same line
+            const qsizetype endPos = line.indexOf(m_verbatimEnd, pos);
+            if (endPos < 0) {
+                break;
+            }
+            pos = endPos + m_verbatimEnd.size();
+            m_verbatimEnd.clear();
+            if (--m_depth == 0) {
+                m_pendingBreak = true;
+            }
+        }
+    }
+
+    return starts && !firstLine;
+}
+
+qsizetype LaTeXBlockSplitter::commentStart(QStringView line) {
+    qsizetype pos = 0;
+    while ((pos = line.indexOf(u'%', pos)) >= 0) {
+        qsizetype backslashes = 0;
+        while (pos - backslashes - 1 >= 0 && line[pos - backslashes - 1] == u'\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 0) {
+            return pos;
+        }
+        ++pos;
+    }
+    return -1;
+}
+
+int LaTeXBlockSplitter::braceBalance(QStringView code) {
+    int balance = 0;
+    for (qsizetype i = 0; i < code.size(); ++i) {
+        const QChar ch = code[i];
+        if (ch == u'\\') {
+            ++i;
+        } else if (ch == u'{') {
+            ++balance;
+        } else if (ch == u'}') {
+            --balance;
+        }
+    }
+    return balance;
+}
+
+bool LaTeXBlockSplitter::isSectioningLine(QStringView trimmed) {
+    if (!trimmed.startsWith(u'\\')) {
+        return false;
+    }
+
+    qsizetype end = 1;
+    while (end < trimmed.size() && trimmed[end].isLetter()) {
+        ++end;
+    }
+    const QStringView name = trimmed.mid(1, end - 1);
+
+    static const QStringView sectioningCommands[] = {
+        u"part", u"chapter", u"section", u"subsection",
+        u"subsubsection", u"paragraph", u"subparagraph"
+    };
+    for (QStringView command : sectioningCommands) {
+        if (name == command) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LaTeXBlockSplitter::isVerbatimEnvironment(QStringView name) {
+    return name == u"verbatim" || name == u"verbatim*" || name == u"Verbatim"
+        || name == u"lstlisting" || name == u"minted" || name == u"comment";
+}
@@ -0,0 +1,45 @@
+// LaTeXBlockSplitter.h
+#ifndef LATEXBLOCKSPLITTER_H
+#define LATEXBLOCKSPLITTER_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// Splits LaTeX source into top-level blocks: paragraphs separated by blank
+// lines, sectioning commands and whole environments. Blocks can be converted
+// independently and their HTML concatenated in order.
+class LaTeXBlockSplitter {
+public:
+    struct Block {
+        qsizetype start;
+        qsizetype length;
+    };
+
+    // Splits a complete document. The blocks cover the source without gaps.
+    static QVector<Block> split(QStringView source);
+
+    // Incremental interface: feed the document line by line (with or without
+    // the trailing newline). Returns true if the line starts a new block.
+    bool startsBlock(QStringView line);
+    // Same, with the column of the line's comment (-1 for none) already known
+    bool startsBlock(QStringView line, qsizetype commentColumn);
+    void reset();
+
+    // Environments whose body is taken literally
+    static bool isVerbatimEnvironment(QStringView name);
+
+private:
+    static qsizetype commentStart(QStringView line);
+    static bool isSectioningLine(QStringView trimmed);
+    // Change in brace depth over 'code', ignoring escaped braces
+    static int braceBalance(QStringView code);
+
+    int m_depth = 0;
+    int m_headingBraces = 0;  // Braces still open in the argument of a sectioning command
+    bool m_pendingBreak = false;
+    bool m_firstLine = true;
+    QString m_verbatimEnd;   // \end{...} that closes the current verbatim environment
+};
+
+#endif // LATEXBLOCKSPLITTER_H
@@ -0,0 +1,55 @@
+// LaTeXCharScanner.cpp
+#include "LaTeXCharScanner.h"
+#include <QtAlgorithms>
+#include <QDebug>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LATEXCHARSCANNER_SSE2
+#include <emmintrin.h>
+#endif
+
+LaTeXCharScanner::LaTeXCharScanner(QLatin1String characters) {
+    for (qsizetype i = 0; i < characters.size(); ++i) {
+        const unsigned char ch = static_cast<unsigned char>(characters.data()[i]);
+        if (ch >= 128 || m_table[ch]) {
+            continue;
+        }
+        if (m_count == MaxCharacters) {
+            qWarning() << "LaTeXCharScanner: too many characters, ignoring" << QChar(ch);
+            continue;
+        }
+        m_table[ch] = true;
+        m_characters[m_count++] = ch;
+    }
+}
+
+qsizetype LaTeXCharScanner::indexIn(const char16_t *data, qsizetype from, qsizetype size) const {
+    qsizetype i = from;
+
+#ifdef LATEXCHARSCANNER_SSE2
+    __m128i needles[MaxCharacters];
+    for (int k = 0; k < m_count; ++k) {
+        needles[k] = _mm_set1_epi16(static_cast<short>(m_characters[k]));
+    }
+
+    for (; i + 8 <= size; i += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i hits = _mm_setzero_si128();
+        for (int k = 0; k < m_count; ++k) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(chunk, needles[k]));
+        }
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            // Two mask bits per UTF-16 code unit
+            return i + qCountTrailingZeroBits(static_cast<quint32>(mask)) / 2;
+        }
+    }
+#endif
+
+    for (; i < size; ++i) {
+        if (contains(data[i])) {
+            return i;
+        }
+    }
+    return size;
+}
@@ -0,0 +1,28 @@
+// LaTeXCharScanner.h
+#ifndef LATEXCHARSCANNER_H
+#define LATEXCHARSCANNER_H
+
+#include <QString>
+
+// Finds the next occurrence of any character from a small ASCII set in UTF-16
+// text. Where SSE2 is available eight code units are tested per step, so long
+// runs of ordinary text are skipped without a per-character branch.
+class LaTeXCharScanner {
+public:
+    static constexpr int MaxCharacters = 16;
+
+    LaTeXCharScanner() = default;
+    explicit LaTeXCharScanner(QLatin1String characters);
+
+    bool contains(char16_t ch) const { return ch < 128 && m_table[ch]; }
+
+    // Index of the first character of the set in [from, size), or size if there is none
+    qsizetype indexIn(const char16_t *data, qsizetype from, qsizetype size) const;
+
+private:
+    bool m_table[128] = {};
+    char16_t m_characters[MaxCharacters] = {};
+    int m_count = 0;
+};
+
+#endif // LATEXCHARSCANNER_H
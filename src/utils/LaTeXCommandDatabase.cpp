@@ -0,0 +1,301 @@
+// LaTeXCommandDatabase.cpp
+#include "LaTeXCommandDatabase.h"
+#include "PerformanceMonitor.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QSettings>
+#include <QStandardPaths>
+
+namespace {
+
+// Part of the index fingerprint: bump when the built-in entries change
+const quint64 BuiltinRevision = 1;
+
+inline bool isAsciiLetter(QChar ch) {
+    const char16_t c = ch.unicode();
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Position after the argument starting at 'pos', or -1 if it is not closed on the line
+qsizetype skipArgument(QStringView line, qsizetype pos) {
+    const QChar open = line[pos];
+    const QChar close = open == u'{' ? u'}' : open == u'[' ? u']' : open == u'(' ? u')' : u'>';
+    int depth = 0;
+    for (; pos < line.size(); ++pos) {
+        if (line[pos] == open) {
+            ++depth;
+        } else if (line[pos] == close && --depth == 0) {
+            return pos + 1;
+        }
+    }
+    return -1;
+}
+
+bool mapIndex(const QString &path, quint64 sourceFingerprint, LaTeXCommandTable &table) {
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 size = file->size();
+    LaTeXCommandTable mapped;
+    if (!LaTeXCommandTable::open(file->map(0, size), size, file, mapped)
+        || mapped.sourceFingerprint() != sourceFingerprint) {
+        return false;
+    }
+    table = mapped;
+    return true;
+}
+
+} // namespace
+
+const LaTeXCommandTable &LaTeXCommandDatabase::commands() {
+    static const LaTeXCommandTable table = load();
+    return table;
+}
+
+LaTeXCommandTable LaTeXCommandDatabase::load() {
+    ScopedTimer timer("Commands: load");
+
+    LaTeXCommandTable::Builder builder;
+    addBuiltinCommands(builder);
+
+    const QList<QFileInfo> wordLists = findWordLists();
+    if (wordLists.isEmpty()) {
+        return builder.build();
+    }
+
+    // Map the index of an earlier run if the word lists did not change
+    const quint64 sourceFingerprint = fingerprint(wordLists);
+    const QString path = cachePath();
+    LaTeXCommandTable table;
+    if (!path.isEmpty() && mapIndex(path, sourceFingerprint, table)) {
+        qDebug() << "Mapped" << table.size() << "commands from" << path;
+        return table;
+    }
+
+    for (const QFileInfo &info : wordLists) {
+        QFile input(info.absoluteFilePath());
+        if (!input.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "Cannot read word list" << input.fileName() << input.errorString();
+            continue;
+        }
+        parseWordList(QString::fromUtf8(input.readAll()), packageName(info.fileName()), builder);
+
+        // Without the kernel list, commands missing from the index may still exist
+        if (info.fileName() == QLatin1String("latex-document.cwl")) {
+            builder.setComplete(true);
+        }
+    }
+    builder.setSourceFingerprint(sourceFingerprint);
+
+    const QByteArray data = builder.serialize();
+    if (!path.isEmpty()) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile output(path);
+        if (!output.open(QIODevice::WriteOnly) || output.write(data) != data.size() || !output.commit()) {
+            qWarning() << "Cannot write command index" << path << output.errorString();
+        }
+    }
+
+    table = LaTeXCommandTable::fromBytes(data);
+    qDebug() << "Compiled" << table.size() << "commands from" << wordLists.size() << "word lists";
+    return table;
+}
+
+void LaTeXCommandDatabase::parseWordList(QStringView text, const QString &package,
+                                         LaTeXCommandTable::Builder &builder) {
+    QStringList includes;
+    bool inKeyValues = false;
+
+    qsizetype lineStart = 0;
+    while (lineStart < text.size()) {
+        qsizetype lineEnd = text.indexOf(u'\n', lineStart);
+        if (lineEnd < 0) {
+            lineEnd = text.size();
+        }
+        const QStringView line = text.mid(lineStart, lineEnd - lineStart).trimmed();
+        lineStart = lineEnd + 1;
+
+        // Directives; key-value lists name options, not commands
+        if (line.startsWith(u'#')) {
+            if (line.startsWith(u"#include:")) {
+                includes.append(line.mid(9).trimmed().toString());
+            } else if (line.startsWith(u"#keyvals:")) {
+                inKeyValues = true;
+            } else if (line.startsWith(u"#endkeyvals")) {
+                inKeyValues = false;
+            }
+            continue;
+        }
+        if (inKeyValues || line.size() < 2 || line[0] != u'\\' || !isAsciiLetter(line[1])) {
+            continue;
+        }
+
+        qsizetype pos = 1;
+        while (pos < line.size() && isAsciiLetter(line[pos])) {
+            ++pos;
+        }
+        const QStringView name = line.mid(1, pos - 1);
+        // Internal names such as \@foo@bar cannot be told apart from \@foo here
+        if ((pos < line.size() && line[pos] == u'@') || name == u"begin" || name == u"end") {
+            continue;
+        }
+        if (pos < line.size() && line[pos] == u'*') {
+            ++pos;
+        }
+
+        int requiredArgs = 0;
+        int optionalArgs = 0;
+        while (pos < line.size()) {
+            const QChar ch = line[pos];
+            if (ch != u'{' && ch != u'[' && ch != u'(' && ch != u'<') {
+                break;
+            }
+            const qsizetype next = skipArgument(line, pos);
+            if (next < 0) {
+                break;
+            }
+            if (ch == u'{') {
+                ++requiredArgs;
+            } else {
+                ++optionalArgs;
+            }
+            pos = next;
+        }
+
+        // Classifiers after '#': m is math mode only, n text mode only, d defines
+        // a command. An environment list after '/' and a key-value reference
+        // after '%' are skipped.
+        quint16 flags = 0;
+        if (pos < line.size() && line[pos] == u'#') {
+            for (++pos; pos < line.size() && line[pos] != u'/' && line[pos] != u'%'; ++pos) {
+                if (line[pos] == u'm') {
+                    flags |= LaTeXCommandInfo::MathOnly;
+                } else if (line[pos] == u'n') {
+                    flags |= LaTeXCommandInfo::TextOnly;
+                } else if (line[pos] == u'd') {
+                    flags |= LaTeXCommandInfo::Definition;
+                }
+            }
+        }
+
+        builder.addCommand(name.toString(), package, requiredArgs, optionalArgs, flags);
+    }
+
+    if (!package.isEmpty()) {
+        builder.addPackage(package, includes);
+    }
+}
+
+QString LaTeXCommandDatabase::packageName(const QString &fileName) {
+    QString name = fileName;
+    if (name.endsWith(QLatin1String(".cwl"))) {
+        name.chop(4);
+    }
+    // TeXstudio names the kernel lists latex-document, latex-mathsymbols, tex, ...
+    if (name == QLatin1String("tex") || name.startsWith(QLatin1String("latex-"))) {
+        return QString();
+    }
+    return name;
+}
+
+void LaTeXCommandDatabase::addBuiltinCommands(LaTeXCommandTable::Builder &builder) {
+    // Math mode commands
+    static const char *const mathCommands[] = {
+        "sum", "int", "prod", "lim",
+        "alpha", "beta", "gamma", "delta", "epsilon",
+        "theta", "lambda", "mu", "pi", "sigma", "omega",
+        "infty", "partial", "nabla", "forall", "exists",
+        "leq", "geq", "neq", "approx", "equiv",
+        "times", "cdot", "pm", "mp"
+    };
+    for (const char *command : mathCommands) {
+        builder.addCommand(QLatin1String(command), QString(), 0, 0, LaTeXCommandInfo::MathOnly);
+    }
+    builder.addCommand("frac", QString(), 2, 0, LaTeXCommandInfo::MathOnly);
+    builder.addCommand("sqrt", QString(), 1, 1, LaTeXCommandInfo::MathOnly);
+
+    // Deprecated commands
+    builder.setReplacement("bf", "\\textbf{} or \\bfseries");
+    builder.setReplacement("it", "\\textit{} or \\itshape");
+    builder.setReplacement("rm", "\\textrm{} or \\rmfamily");
+    builder.setReplacement("tt", "\\texttt{} or \\ttfamily");
+    builder.setReplacement("sc", "\\textsc{} or \\scshape");
+    builder.setReplacement("sf", "\\textsf{} or \\sffamily");
+    for (const char *command : {"over", "atop", "above", "choose"}) {
+        builder.setReplacement(QLatin1String(command), "(see LaTeX documentation)");
+    }
+
+    // Package-specific commands
+    builder.addCommand("includegraphics", "graphicx", 1, 1);
+    builder.addCommand("url", "url", 1);
+    builder.addCommand("href", "hyperref", 2);
+    builder.addCommand("cite", "natbib", 1, 1);
+    builder.addCommand("citep", "natbib", 1, 2);
+    builder.addCommand("citet", "natbib", 1, 2);
+    builder.addCommand("textcolor", "xcolor", 2, 1);
+    builder.addCommand("definecolor", "xcolor", 3);
+    builder.addCommand("listings", "listings");
+    builder.addCommand("lstlisting", "listings");
+}
+
+QList<QFileInfo> LaTeXCommandDatabase::findWordLists() {
+    QStringList directories = qEnvironmentVariable("LATEXEDITOR_CWL_PATH")
+        .split(QDir::listSeparator(), Qt::SkipEmptyParts);
+    QSettings settings;
+    directories += settings.value("checker/cwlPaths").toStringList();
+    const QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (!dataPath.isEmpty()) {
+        directories.append(QDir(dataPath).filePath("cwl"));
+    }
+
+    // A word list found in several directories is taken from the first
+    QList<QFileInfo> wordLists;
+    QSet<QString> names;
+    for (const QString &directory : directories) {
+        const QFileInfoList entries = QDir(directory).entryInfoList(
+            QStringList() << "*.cwl", QDir::Files | QDir::Readable, QDir::Name);
+        for (const QFileInfo &entry : entries) {
+            if (!names.contains(entry.fileName())) {
+                names.insert(entry.fileName());
+                wordLists.append(entry);
+            }
+        }
+    }
+    return wordLists;
+}
+
+quint64 LaTeXCommandDatabase::fingerprint(const QList<QFileInfo> &wordLists) {
+    // FNV-1a over the path, size and modification time of every word list
+    quint64 h = 14695981039346656037ull;
+    auto mix = [&h](const void *data, size_t size) {
+        const uchar *bytes = static_cast<const uchar *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+    };
+
+    mix(&BuiltinRevision, sizeof(BuiltinRevision));
+    for (const QFileInfo &info : wordLists) {
+        const QString path = info.absoluteFilePath();
+        const qint64 size = info.size();
+        const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        mix(path.utf16(), path.size() * sizeof(char16_t));
+        mix(&size, sizeof(size));
+        mix(&modified, sizeof(modified));
+    }
+    return h;
+}
+
+QString LaTeXCommandDatabase::cachePath() {
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheDir.isEmpty()) {
+        return QString();
+    }
+    return QDir(cacheDir).filePath("commands.idx");
+}
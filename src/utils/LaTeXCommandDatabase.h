@@ -0,0 +1,38 @@
+// LaTeXCommandDatabase.h
+#ifndef LATEXCOMMANDDATABASE_H
+#define LATEXCOMMANDDATABASE_H
+
+#include <QFileInfo>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include "LaTeXCommandTable.h"
+
+// The commands known to the error checker: a few built-in entries plus every
+// completion word list (.cwl, as used by TeXstudio) found in the search path:
+//   1. LATEXEDITOR_CWL_PATH, separated like PATH
+//   2. The "checker/cwlPaths" setting
+//   3. A "cwl" directory in the application data location
+// The word lists are compiled into a binary index in the cache directory.
+// Later runs map that index into memory instead of parsing the lists again,
+// as long as no word list was added, removed or modified.
+class LaTeXCommandDatabase {
+public:
+    // Loaded once per process and shared by all checkers
+    static const LaTeXCommandTable &commands();
+
+    // Adds the commands of one word list. 'package' is empty for the kernel.
+    static void parseWordList(QStringView text, const QString &package, LaTeXCommandTable::Builder &builder);
+    // "graphicx.cwl" defines package graphicx, "latex-document.cwl" the kernel
+    static QString packageName(const QString &fileName);
+
+private:
+    static LaTeXCommandTable load();
+    static void addBuiltinCommands(LaTeXCommandTable::Builder &builder);
+    static QList<QFileInfo> findWordLists();
+    static quint64 fingerprint(const QList<QFileInfo> &wordLists);
+    static QString cachePath();
+};
+
+#endif // LATEXCOMMANDDATABASE_H
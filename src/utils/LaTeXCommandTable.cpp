@@ -0,0 +1,266 @@
+// LaTeXCommandTable.cpp
+#include "LaTeXCommandTable.h"
+#include <QHash>
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Data is written in native byte order; a table from a machine with another
+// byte order fails the version check and is rebuilt
+const char Magic[8] = {'L', 'T', 'X', 'C', 'M', 'D', 'S', '\0'};
+const quint32 FormatVersion = 1;
+
+} // namespace
+
+void LaTeXCommandTable::Builder::addCommand(const QString &name, const QString &package,
+                                            int requiredArgs, int optionalArgs, quint16 flags) {
+    Pending &command = m_commands[name];
+
+    if (package.isEmpty()) {
+        command.kernel = true;
+    } else if (!command.packages.contains(package)) {
+        command.packages.append(package);
+    }
+
+    const quint16 mode = flags & (LaTeXCommandInfo::MathOnly | LaTeXCommandInfo::TextOnly);
+    if (command.hasForm) {
+        command.requiredArgs = std::min(command.requiredArgs, requiredArgs);
+        command.optionalArgs = std::max(command.optionalArgs, optionalArgs);
+        command.modeFlags &= mode;
+    } else {
+        command.hasForm = true;
+        command.requiredArgs = requiredArgs;
+        command.optionalArgs = optionalArgs;
+        command.modeFlags = mode;
+    }
+    command.flags |= flags & ~mode;
+}
+
+void LaTeXCommandTable::Builder::setReplacement(const QString &name, const QString &replacement) {
+    Pending &command = m_commands[name];
+    command.replacement = replacement;
+    command.flags |= LaTeXCommandInfo::Deprecated;
+}
+
+void LaTeXCommandTable::Builder::addPackage(const QString &package, const QStringList &includes) {
+    QStringList &known = m_packages[package];
+    for (const QString &include : includes) {
+        if (!known.contains(include)) {
+            known.append(include);
+        }
+    }
+}
+
+QByteArray LaTeXCommandTable::Builder::serialize() const {
+    // Equal strings (most packages) are stored once
+    QString strings;
+    QHash<QString, quint32> stringOffsets;
+    auto addString = [&](const QString &text) -> quint32 {
+        const auto it = stringOffsets.constFind(text);
+        if (it != stringOffsets.constEnd()) {
+            return it.value();
+        }
+        const quint32 offset = static_cast<quint32>(strings.size());
+        strings += text;
+        stringOffsets.insert(text, offset);
+        return offset;
+    };
+    auto length = [](const QString &text) {
+        return static_cast<quint16>(std::min<qsizetype>(text.size(), 0xFFFF));
+    };
+
+    QVector<Entry> entries;
+    entries.reserve(m_commands.size());
+    for (auto it = m_commands.constBegin(); it != m_commands.constEnd(); ++it) {
+        const Pending &command = it.value();
+        const QString package = command.kernel ? QString() : command.packages.join(QLatin1Char(','));
+
+        Entry entry = {};
+        entry.hash = hash(it.key());
+        entry.nameOffset = addString(it.key());
+        entry.nameLength = length(it.key());
+        entry.packageOffset = addString(package);
+        entry.packageLength = length(package);
+        entry.replacementOffset = addString(command.replacement);
+        entry.replacementLength = length(command.replacement);
+        entry.flags = command.flags | command.modeFlags;
+        entry.requiredArgs = static_cast<quint8>(std::clamp(command.requiredArgs, 0, 0xFF));
+        entry.optionalArgs = static_cast<quint8>(std::clamp(command.optionalArgs, 0, 0xFF));
+        entries.append(entry);
+    }
+
+    // At most half full, so probe sequences stay short
+    quint32 slotCount = 0;
+    if (!entries.isEmpty()) {
+        slotCount = 8;
+        while (slotCount < static_cast<quint64>(entries.size()) * 2) {
+            slotCount *= 2;
+        }
+    }
+    QVector<quint32> slotTable(slotCount, 0);
+    const quint32 mask = slotCount - 1;
+    for (qsizetype i = 0; i < entries.size(); ++i) {
+        quint32 slot = entries[i].hash & mask;
+        while (slotTable[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slotTable[slot] = static_cast<quint32>(i + 1);
+    }
+
+    QVector<PackageEntry> packages;
+    packages.reserve(m_packages.size());
+    for (auto it = m_packages.constBegin(); it != m_packages.constEnd(); ++it) {
+        const QString includes = it.value().join(QLatin1Char(','));
+        PackageEntry package = {};
+        package.nameOffset = addString(it.key());
+        package.nameLength = length(it.key());
+        package.includesOffset = addString(includes);
+        package.includesLength = length(includes);
+        packages.append(package);
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.flags = m_complete ? quint32(Complete) : 0u;
+    header.sourceFingerprint = m_fingerprint;
+    header.entryCount = static_cast<quint32>(entries.size());
+    header.slotCount = slotCount;
+    header.packageCount = static_cast<quint32>(packages.size());
+    header.stringLength = static_cast<quint32>(strings.size());
+
+    // Header, entries, slots, packages and strings, each suitably aligned after the one before
+    QByteArray data;
+    data.reserve(sizeof(Header) + entries.size() * sizeof(Entry) + slotTable.size() * sizeof(quint32)
+                 + packages.size() * sizeof(PackageEntry) + strings.size() * sizeof(char16_t));
+    data.append(reinterpret_cast<const char *>(&header), sizeof(Header));
+    data.append(reinterpret_cast<const char *>(entries.constData()), entries.size() * sizeof(Entry));
+    data.append(reinterpret_cast<const char *>(slotTable.constData()), slotTable.size() * sizeof(quint32));
+    data.append(reinterpret_cast<const char *>(packages.constData()), packages.size() * sizeof(PackageEntry));
+    data.append(reinterpret_cast<const char *>(strings.utf16()), strings.size() * sizeof(char16_t));
+    return data;
+}
+
+LaTeXCommandTable LaTeXCommandTable::Builder::build() const {
+    return fromBytes(serialize());
+}
+
+bool LaTeXCommandTable::open(const uchar *data, qint64 size, std::shared_ptr<const void> owner,
+                             LaTeXCommandTable &table) {
+    Header header;
+    if (!data || size < static_cast<qint64>(sizeof(Header))) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != FormatVersion) {
+        return false;
+    }
+    if ((header.slotCount & (header.slotCount - 1)) != 0 || header.slotCount < header.entryCount) {
+        return false;
+    }
+
+    const qint64 entriesOffset = sizeof(Header);
+    const qint64 slotsOffset = entriesOffset + qint64(header.entryCount) * qint64(sizeof(Entry));
+    const qint64 packagesOffset = slotsOffset + qint64(header.slotCount) * qint64(sizeof(quint32));
+    const qint64 stringsOffset = packagesOffset + qint64(header.packageCount) * qint64(sizeof(PackageEntry));
+    if (stringsOffset + qint64(header.stringLength) * qint64(sizeof(char16_t)) != size) {
+        return false;
+    }
+
+    table.m_header = header;
+    table.m_entries = reinterpret_cast<const Entry *>(data + entriesOffset);
+    table.m_slots = reinterpret_cast<const quint32 *>(data + slotsOffset);
+    table.m_packages = reinterpret_cast<const PackageEntry *>(data + packagesOffset);
+    table.m_strings = reinterpret_cast<const char16_t *>(data + stringsOffset);
+    table.m_owner = std::move(owner);
+    return true;
+}
+
+LaTeXCommandTable LaTeXCommandTable::fromBytes(const QByteArray &data) {
+    // The copy keeps the bytes alive without detaching them
+    auto owner = std::make_shared<const QByteArray>(data);
+    LaTeXCommandTable table;
+    if (!open(reinterpret_cast<const uchar *>(owner->constData()), owner->size(), owner, table)) {
+        return LaTeXCommandTable();
+    }
+    return table;
+}
+
+quint32 LaTeXCommandTable::hash(QStringView name) {
+    // FNV-1a over the UTF-16 code units
+    quint32 h = 2166136261u;
+    for (QChar ch : name) {
+        h ^= ch.unicode();
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int LaTeXCommandTable::size() const {
+    return static_cast<int>(m_header.entryCount);
+}
+
+bool LaTeXCommandTable::isComplete() const {
+    return m_header.flags & Complete;
+}
+
+quint64 LaTeXCommandTable::sourceFingerprint() const {
+    return m_header.sourceFingerprint;
+}
+
+QStringView LaTeXCommandTable::string(quint32 offset, quint16 length) const {
+    // Offsets are only checked when used, so opening a large table costs nothing
+    if (qint64(offset) + length > m_header.stringLength) {
+        return QStringView();
+    }
+    return QStringView(m_strings + offset, length);
+}
+
+bool LaTeXCommandTable::lookup(QStringView name, LaTeXCommandInfo &info) const {
+    if (m_header.slotCount == 0) {
+        return false;
+    }
+
+    const quint32 h = hash(name);
+    const quint32 mask = m_header.slotCount - 1;
+    quint32 slot = h & mask;
+
+    for (quint32 probes = 0; probes < m_header.slotCount && m_slots[slot] != 0; ++probes, slot = (slot + 1) & mask) {
+        const quint32 index = m_slots[slot] - 1;
+        if (index >= m_header.entryCount) {
+            return false;
+        }
+        const Entry &entry = m_entries[index];
+        if (entry.hash != h || entry.nameLength != name.size()) {
+            continue;
+        }
+        const QStringView entryName = string(entry.nameOffset, entry.nameLength);
+        if (entryName != name) {
+            continue;
+        }
+        info.name = entryName;
+        info.package = string(entry.packageOffset, entry.packageLength);
+        info.replacement = string(entry.replacementOffset, entry.replacementLength);
+        info.requiredArgs = entry.requiredArgs;
+        info.optionalArgs = entry.optionalArgs;
+        info.flags = entry.flags;
+        return true;
+    }
+    return false;
+}
+
+bool LaTeXCommandTable::findPackage(QStringView package, QStringView &includes) const {
+    const PackageEntry *begin = m_packages;
+    const PackageEntry *end = m_packages + m_header.packageCount;
+    const PackageEntry *found = std::lower_bound(begin, end, package,
+        [this](const PackageEntry &entry, QStringView name) {
+            return string(entry.nameOffset, entry.nameLength) < name;
+        });
+    if (found == end || string(found->nameOffset, found->nameLength) != package) {
+        return false;
+    }
+    includes = string(found->includesOffset, found->includesLength);
+    return true;
+}
@@ -0,0 +1,136 @@
+// LaTeXCommandTable.h
+#ifndef LATEXCOMMANDTABLE_H
+#define LATEXCOMMANDTABLE_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <memory>
+
+// Everything the error checker knows about one command name
+struct LaTeXCommandInfo {
+    enum Flag : quint16 {
+        Deprecated = 0x1,
+        MathOnly = 0x2,
+        TextOnly = 0x4,
+        Definition = 0x8    // The first argument names a new command
+    };
+
+    QStringView name;
+    QStringView package;       // Comma-separated packages that define the command, empty for the kernel
+    QStringView replacement;   // Suggested replacement of a deprecated command
+    int requiredArgs = 0;      // Fewest mandatory arguments of any known form
+    int optionalArgs = 0;
+    quint16 flags = 0;
+};
+
+// Command names compiled into one open-addressing hash table. Any number of
+// rules is answered by a single lookup per command token, without building a
+// QString. The table is a single block of flat arrays: it is used in place,
+// whether built in memory or mapped from a file written by an earlier run.
+class LaTeXCommandTable {
+public:
+    // Collects commands; a name added twice merges its fields
+    class Builder {
+    public:
+        // Adds one form of a command. Forms of the same name are merged: the
+        // fewest required and the most optional arguments are kept, a mode
+        // restriction only if every form has it, and every defining package.
+        void addCommand(const QString &name, const QString &package,
+                        int requiredArgs = 0, int optionalArgs = 0, quint16 flags = 0);
+        void setReplacement(const QString &name, const QString &replacement);
+        // A package with a word list; loading it also loads 'includes'
+        void addPackage(const QString &package, const QStringList &includes);
+        // Set when the kernel commands are known, so a missing name is really unknown
+        void setComplete(bool complete) { m_complete = complete; }
+        void setSourceFingerprint(quint64 fingerprint) { m_fingerprint = fingerprint; }
+
+        QByteArray serialize() const;
+        LaTeXCommandTable build() const;
+
+    private:
+        struct Pending {
+            QStringList packages;
+            bool kernel = false;
+            bool hasForm = false;
+            QString replacement;
+            int requiredArgs = 0;
+            int optionalArgs = 0;
+            quint16 modeFlags = 0;
+            quint16 flags = 0;
+        };
+        QMap<QString, Pending> m_commands;   // Sorted, so equal input gives equal bytes
+        QMap<QString, QStringList> m_packages;
+        bool m_complete = false;
+        quint64 m_fingerprint = 0;
+    };
+
+    // Uses bytes written by Builder::serialize without copying them. 'owner'
+    // keeps 'data' alive as long as any copy of the table exists. Returns
+    // false if the data has the wrong format or size.
+    static bool open(const uchar *data, qint64 size, std::shared_ptr<const void> owner,
+                     LaTeXCommandTable &table);
+    // Same for bytes held in memory; an invalid table is returned empty
+    static LaTeXCommandTable fromBytes(const QByteArray &data);
+
+    bool lookup(QStringView name, LaTeXCommandInfo &info) const;
+    // Returns false if the package has no word list
+    bool findPackage(QStringView package, QStringView &includes) const;
+
+    int size() const;
+    bool isComplete() const;
+    quint64 sourceFingerprint() const;
+
+    // Stable across runs and platforms, unlike qHash
+    static quint32 hash(QStringView name);
+
+private:
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 flags;
+        quint64 sourceFingerprint;
+        quint32 entryCount;
+        quint32 slotCount;          // Power of two, or 0 for an empty table
+        quint32 packageCount;
+        quint32 stringLength;       // UTF-16 code units
+    };
+
+    enum HeaderFlag : quint32 {
+        Complete = 0x1
+    };
+
+    struct Entry {
+        quint32 hash;
+        quint32 nameOffset;
+        quint32 packageOffset;
+        quint32 replacementOffset;
+        quint16 nameLength;
+        quint16 packageLength;
+        quint16 replacementLength;
+        quint16 flags;
+        quint8 requiredArgs;
+        quint8 optionalArgs;
+        quint16 reserved;
+    };
+
+    struct PackageEntry {
+        quint32 nameOffset;
+        quint32 includesOffset;
+        quint16 nameLength;
+        quint16 includesLength;
+    };
+
+    QStringView string(quint32 offset, quint16 length) const;
+
+    Header m_header = {};
+    const Entry *m_entries = nullptr;
+    const quint32 *m_slots = nullptr;        // Entry index + 1, 0 for an empty slot
+    const PackageEntry *m_packages = nullptr; // Sorted by name
+    const char16_t *m_strings = nullptr;      // All names, packages, replacements and includes
+    std::shared_ptr<const void> m_owner;
+};
+
+#endif // LATEXCOMMANDTABLE_H
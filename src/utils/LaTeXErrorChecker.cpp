@@ -1,514 +1,1394 @@
 #include "LaTeXErrorChecker.h"
-#include <QRegularExpression>
-#include <QStack>
+#include "LaTeXBlockSplitter.h"
+#include "PerformanceMonitor.h"
 #include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// ASCII word characters, matching \w in the old per-line expressions
+inline bool isWordChar(QChar ch) {
+    const char16_t c = ch.unicode();
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
 
-LaTeXErrorChecker::LaTeXErrorChecker(QObject *parent) : QObject(parent) {
-    initializeCommandDatabase();
-    initializePackageDatabase();
+inline bool isSpace(char16_t c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
 }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkDocument(const QString &content) {
-    QVector<LaTeXError> errors;
+// Matches a single variable compared to a number, such as "x = 5" or "n<10",
+// starting at 'pos'. Returns the length of the match or 0.
+qsizetype matchBareComparison(QStringView text, qsizetype pos) {
+    static const QStringView variables = u"xyznijk";
+    const qsizetype size = text.size();
+    if (!variables.contains(text[pos]) || (pos > 0 && isWordChar(text[pos - 1]))) {
+        return 0;
+    }
+
+    qsizetype end = pos + 1;
+    while (end < size && isSpace(text[end].unicode())) {
+        ++end;
+    }
+    if (end >= size || (text[end] != u'=' && text[end] != u'<' && text[end] != u'>')) {
+        return 0;
+    }
+    ++end;
+    while (end < size && isSpace(text[end].unicode())) {
+        ++end;
+    }
+
+    const qsizetype digitsStart = end;
+    while (end < size && text[end].isDigit()) {
+        ++end;
+    }
+    if (end == digitsStart || (end < size && isWordChar(text[end]))) {
+        return 0;
+    }
+    return end - pos;
+}
 
-    // Check braces and brackets
-    errors.append(checkBraces(content));
+// Lines scanned between two cancellation checks
+constexpr int CancelCheckInterval = 64;
 
-    // Check environments
-    errors.append(checkEnvironments(content));
+// Checked at the start of 'line'; the clock is only read every few lines
+bool limitReached(const LaTeXErrorChecker::Limits &limits, const QElapsedTimer &timer,
+                  qsizetype errorCount, int line) {
+    return (limits.maxErrors > 0 && errorCount >= limits.maxErrors)
+        || (limits.timeBudgetMs > 0 && line % CancelCheckInterval == 0 && timer.elapsed() >= limits.timeBudgetMs);
+}
 
-    // Check math delimiters
-    errors.append(checkMathDelimiters(content));
+void truncateErrors(QVector<LaTeXError> &errors, int maxErrors) {
+    if (maxErrors > 0 && errors.size() > maxErrors) {
+        errors.remove(maxErrors, errors.size() - maxErrors);
+    }
+}
 
-    // Check commands (semantic validation)
-    errors.append(checkCommands(content));
+// Counts one evaluation of a rule and adds its time, if profiling
+class RuleTimer {
+public:
+    explicit RuleTimer(LaTeXErrorChecker::RuleStats *stats) : m_stats(stats) {
+        if (m_stats) {
+            ++m_stats->runs;
+            m_timer.start();
+        }
+    }
 
-    // Check packages
-    errors.append(checkPackages(content));
+    ~RuleTimer() {
+        if (m_stats) {
+            m_stats->nanoseconds += m_timer.nsecsElapsed();
+        }
+    }
 
-    // Check common mistakes
-    errors.append(checkCommonMistakes(content));
+    RuleTimer(const RuleTimer &) = delete;
+    RuleTimer &operator=(const RuleTimer &) = delete;
 
-    return errors;
-}
+private:
+    LaTeXErrorChecker::RuleStats *m_stats;
+    QElapsedTimer m_timer;
+};
 
-bool LaTeXErrorChecker::isInComment(const QString &line, int position) {
-    // Check if position is after a % that's not escaped
-    for (int i = 0; i < position && i < line.length(); ++i) {
-        if (line[i] == '%' && (i == 0 || line[i-1] != '\\')) {
+// Records the time each rule took during one check in PerformanceMonitor
+class RuleTimingScope {
+public:
+    explicit RuleTimingScope(const LaTeXErrorChecker &checker) : m_checker(checker) {
+        if (checker.isProfilingEnabled() && PerformanceMonitor::getInstance().isEnabled()) {
+            m_before = checker.ruleStats();
+        }
+    }
+
+    ~RuleTimingScope() {
+        if (m_before.isEmpty()) {
+            return;
+        }
+        const QVector<LaTeXErrorChecker::RuleStats> after = m_checker.ruleStats();
+        for (int rule = 0; rule < LaTeXErrorChecker::RuleCount; ++rule) {
+            const qint64 nanoseconds = after[rule].nanoseconds - m_before[rule].nanoseconds;
+            if (nanoseconds > 0) {
+                PerformanceMonitor::getInstance().record(
+                    QLatin1String("Rules: ") + LaTeXErrorChecker::ruleName(static_cast<LaTeXErrorChecker::Rule>(rule)),
+                    nanoseconds);
+            }
+        }
+    }
+
+    RuleTimingScope(const RuleTimingScope &) = delete;
+    RuleTimingScope &operator=(const RuleTimingScope &) = delete;
+
+private:
+    const LaTeXErrorChecker &m_checker;
+    QVector<LaTeXErrorChecker::RuleStats> m_before;
+};
+
+const char *const RuleNames[LaTeXErrorChecker::RuleCount] = {
+    "braces",
+    "environments",
+    "math-delimiters",
+    "command-spacing",
+    "package-order",
+    "unknown-commands",
+    "argument-count",
+    "math-mode",
+    "missing-packages",
+    "deprecated-commands",
+    "multiple-spaces",
+    "bare-math",
+    "line-breaks"
+};
+
+bool isMathEnvironment(QStringView name) {
+    if (name.endsWith(u'*')) {
+        name.chop(1);
+    }
+    static const QStringView environments[] = {
+        u"equation", u"align", u"alignat", u"flalign", u"gather", u"multline", u"eqnarray",
+        u"math", u"displaymath", u"split", u"aligned", u"alignedat", u"gathered", u"cases",
+        u"array", u"matrix", u"pmatrix", u"bmatrix", u"Bmatrix", u"vmatrix", u"Vmatrix", u"smallmatrix"
+    };
+    for (QStringView environment : environments) {
+        if (name == environment) {
             return true;
         }
     }
     return false;
 }
 
-void LaTeXErrorChecker::getLineColumn(const QString &content, int position, int &line, int &column) {
-    line = 0;
-    column = 0;
-
-    for (int i = 0; i < position && i < content.length(); ++i) {
-        if (content[i] == '\n') {
-            line++;
-            column = 0;
-        } else {
-            column++;
+// Commands whose arguments are code to run later, not text typeset here
+bool isDefinitionCommand(QStringView name) {
+    static const QStringView commands[] = {
+        u"newcommand", u"renewcommand", u"providecommand", u"DeclareRobustCommand",
+        u"NewDocumentCommand", u"RenewDocumentCommand", u"ProvideDocumentCommand", u"DeclareDocumentCommand",
+        u"DeclareMathOperator", u"def", u"gdef", u"edef", u"xdef", u"let",
+        u"newenvironment", u"renewenvironment", u"ensuremath"
+    };
+    for (QStringView command : commands) {
+        if (name == command) {
+            return true;
         }
     }
+    return false;
 }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkBraces(const QString &content) {
-    QVector<LaTeXError> errors;
-    QStack<BraceInfo> braceStack;
-    QStack<BraceInfo> bracketStack;
+// Commands that read another file, which may define commands of its own
+bool isInputCommand(QStringView name) {
+    return name == u"input" || name == u"include" || name == u"subfile"
+        || name == u"import" || name == u"subimport" || name == u"InputIfFileExists";
+}
 
-    QStringList lines = content.split('\n');
+// Classes whose commands all come from the kernel
+bool isStandardClass(QStringView name) {
+    return name == u"article" || name == u"report" || name == u"book" || name == u"letter"
+        || name == u"proc" || name == u"slides" || name == u"minimal";
+}
 
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
+// Returns true if fewer than 'required' arguments follow 'pos' on the same
+// line: the argument list runs into a closing brace, an alignment tab, a
+// math shift or the end of the document. Optional [] arguments are skipped.
+// An argument list that continues on the next line is assumed complete, so
+// the result never depends on later lines.
+bool missingArgument(QStringView content, qsizetype pos, int required) {
+    const qsizetype size = content.size();
+    if (pos < size && content[pos] == u'*') {
+        ++pos;
+    }
 
-        for (int col = 0; col < line.length(); ++col) {
-            // Skip if in comment
-            if (isInComment(line, col)) {
-                break;
+    // End of the group that starts at 'pos', or -1 if it does not close on the line
+    auto skipGroup = [&](QChar open, QChar close) -> qsizetype {
+        int depth = 0;
+        for (qsizetype i = pos; i < size && content[i] != u'\n'; ++i) {
+            const QChar ch = content[i];
+            if (ch == u'\\') {
+                ++i;
+            } else if (ch == open) {
+                ++depth;
+            } else if (ch == close && --depth == 0) {
+                return i + 1;
             }
+        }
+        return -1;
+    };
 
-            QChar ch = line[col];
+    for (int found = 0; found < required;) {
+        while (pos < size && isSpace(content[pos].unicode())) {
+            ++pos;
+        }
+        if (pos >= size) {
+            return true;
+        }
 
-            // Skip escaped braces
-            if (col > 0 && line[col-1] == '\\') {
-                continue;
+        const QChar ch = content[pos];
+        if (ch == u'\n' || ch == u'%') {
+            return false;
+        }
+        if (ch == u'}' || ch == u'&' || ch == u'$') {
+            return true;
+        }
+        if (ch == u'[' || ch == u'{') {
+            const qsizetype end = ch == u'[' ? skipGroup(u'[', u']') : skipGroup(u'{', u'}');
+            if (end < 0) {
+                return false;
+            }
+            pos = end;
+            if (ch == u'{') {
+                ++found;
             }
+            continue;
+        }
 
-            if (ch == '{') {
-                braceStack.push({lineNum, col, '{'});
-            } else if (ch == '}') {
-                if (braceStack.isEmpty()) {
-                    errors.append(LaTeXError(
-                        LaTeXError::UnmatchedBrace,
-                        lineNum,
-                        col,
-                        "Unmatched closing brace '}'",
-                        "}"
-                    ));
-                } else {
-                    braceStack.pop();
-                }
-            } else if (ch == '[') {
-                bracketStack.push({lineNum, col, '['});
-            } else if (ch == ']') {
-                if (!bracketStack.isEmpty()) {
-                    bracketStack.pop();
+        // A single token: a command or one character
+        ++pos;
+        if (ch == u'\\' && pos < size) {
+            if (content[pos].isLetter()) {
+                while (pos < size && content[pos].isLetter()) {
+                    ++pos;
                 }
-                // Don't report unmatched ] as error since they're often optional
+            } else {
+                ++pos;
             }
         }
+        ++found;
     }
+    return false;
+}
 
-    // Report unclosed braces
-    while (!braceStack.isEmpty()) {
-        BraceInfo info = braceStack.pop();
-        errors.append(LaTeXError(
-            LaTeXError::UnmatchedBrace,
-            info.line,
-            info.column,
-            "Unclosed brace '{'",
-            "{"
-        ));
+bool errorBefore(const LaTeXError &a, const LaTeXError &b) {
+    return a.line != b.line ? a.line < b.line : a.column < b.column;
+}
+
+// Replaces the elements [from, to) of 'items' with 'replacement'
+template <typename T>
+void replaceRange(QVector<T> &items, qsizetype from, qsizetype to, QVector<T> &&replacement) {
+    const qsizetype common = std::min(to - from, replacement.size());
+    std::move(replacement.begin(), replacement.begin() + common, items.begin() + from);
+    if (replacement.size() > common) {
+        items.insert(to, replacement.size() - common, replacement[common]);
+        std::move(replacement.begin() + common, replacement.end(), items.begin() + to);
+    } else {
+        items.remove(from + common, to - from - common);
     }
+}
 
-    // Report unclosed brackets
-    while (!bracketStack.isEmpty()) {
-        BraceInfo info = bracketStack.pop();
-        errors.append(LaTeXError(
-            LaTeXError::UnmatchedBracket,
-            info.line,
-            info.column,
-            "Unclosed bracket '['",
-            "["
-        ));
+// Length of the common prefix, compared in blocks
+qsizetype commonPrefixLength(QStringView a, QStringView b) {
+    constexpr qsizetype BlockSize = 64;
+    const qsizetype size = std::min(a.size(), b.size());
+    qsizetype length = 0;
+    while (length + BlockSize <= size
+           && std::memcmp(a.utf16() + length, b.utf16() + length, BlockSize * sizeof(char16_t)) == 0) {
+        length += BlockSize;
+    }
+    while (length < size && a[length] == b[length]) {
+        ++length;
     }
+    return length;
+}
 
-    return errors;
+qsizetype commonSuffixLength(QStringView a, QStringView b) {
+    constexpr qsizetype BlockSize = 64;
+    const qsizetype size = std::min(a.size(), b.size());
+    const char16_t *endA = a.utf16() + a.size();
+    const char16_t *endB = b.utf16() + b.size();
+    qsizetype length = 0;
+    while (length + BlockSize <= size
+           && std::memcmp(endA - length - BlockSize, endB - length - BlockSize, BlockSize * sizeof(char16_t)) == 0) {
+        length += BlockSize;
+    }
+    while (length < size && endA[-length - 1] == endB[-length - 1]) {
+        ++length;
+    }
+    return length;
+}
+
+} // namespace
+
+QString LaTeXError::message() const {
+    switch (messageId) {
+        case MessageId::UnmatchedClosingBrace:
+            return QStringLiteral("Unmatched closing brace '}'");
+        case MessageId::UnclosedBrace:
+            return QStringLiteral("Unclosed brace '{'");
+        case MessageId::UnclosedBracket:
+            return QStringLiteral("Unclosed bracket '['");
+        case MessageId::UnmatchedEnd:
+            return QStringLiteral("Unmatched \\end{%1}").arg(argument);
+        case MessageId::EnvironmentMismatch:
+            return QStringLiteral("Environment mismatch: expected \\end{%1} but found \\end{%2}")
+                .arg(argument, argument2);
+        case MessageId::UnclosedEnvironment:
+            return QStringLiteral("Unclosed environment: \\begin{%1}").arg(argument);
+        case MessageId::UnmatchedInlineMath:
+            return QStringLiteral("Unmatched math delimiters \\( \\): %1 %2")
+                .arg(number > 0 ? "unclosed" : "extra closing")
+                .arg(qAbs(number));
+        case MessageId::UnmatchedDisplayMath:
+            return QStringLiteral("Unmatched math delimiters \\[ \\]: %1 %2")
+                .arg(number > 0 ? "unclosed" : "extra closing")
+                .arg(qAbs(number));
+        case MessageId::UnmatchedDollar:
+            return QStringLiteral("Unmatched math delimiter '$' (inline math must be closed on same line)");
+        case MessageId::MissingSpaceAfterCommand:
+            return QStringLiteral("Missing space or {} after command \\%1").arg(argument);
+        case MessageId::UsePackageAfterBeginDocument:
+            return QStringLiteral("\\usepackage must be used before \\begin{document} (line %1)").arg(number + 1);
+        case MessageId::UnknownCommand:
+            return QStringLiteral("Unknown command \\%1").arg(argument);
+        case MessageId::ArgumentCount:
+            return QStringLiteral("Command \\%1 expects %2 argument(s)").arg(argument).arg(number);
+        case MessageId::MathOnlyCommand:
+            return QStringLiteral("Command \\%1 is only allowed in math mode").arg(argument);
+        case MessageId::PackageRequired:
+            return QStringLiteral("Command \\%1 requires package '%2'")
+                .arg(argument, QString(argument2).replace(QLatin1String(","), QLatin1String("' or '")));
+        case MessageId::DeprecatedCommand:
+            return QStringLiteral("Deprecated command \\%1, use %2 instead").arg(argument, argument2);
+        case MessageId::MultipleSpaces:
+            return QStringLiteral("Multiple consecutive spaces (LaTeX ignores extra spaces, but this may be unintentional)");
+        case MessageId::BareMathExpression:
+            return QStringLiteral("Mathematical expression should be in math mode ($...$)");
+        case MessageId::LineBreakOutsideTable:
+            return QStringLiteral("Use of \\\\ outside table/array environment (use \\par or blank line for paragraphs)");
+    }
+    return QString();
 }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkEnvironments(const QString &content) {
+LaTeXError::Severity LaTeXError::severity() const {
+    switch (messageId) {
+        case MessageId::MissingSpaceAfterCommand:
+        case MessageId::UnknownCommand:
+        case MessageId::DeprecatedCommand:
+        case MessageId::BareMathExpression:
+        case MessageId::LineBreakOutsideTable:
+            return Warning;
+        case MessageId::MultipleSpaces:
+            return Information;
+        default:
+            return Error;
+    }
+}
+
+LaTeXErrorChecker::LaTeXErrorChecker(QObject *parent)
+    : QObject(parent)
+    , m_commands(LaTeXCommandDatabase::commands())
+{
+}
+
+QVector<LaTeXError> LaTeXErrorChecker::checkDocument(const QString &content, bool *complete) {
+    ScopedTimer totalTimer("Errors: total");
+    RuleTimingScope ruleTimings(*this);
     QVector<LaTeXError> errors;
-    QStack<EnvironmentInfo> envStack;
+    QElapsedTimer timer;
+    timer.start();
+    bool stopped = false;
+
+    // Without limits there is nothing to do at the start of a line
+    LineCallback lineStarted;
+    if (m_limits.timeBudgetMs > 0 || m_limits.maxErrors > 0) {
+        lineStarted = [&](int line, qsizetype, const ScanState &) {
+            stopped = limitReached(m_limits, timer, errors.size(), line);
+            return !stopped;
+        };
+    }
 
-    QRegularExpression beginRegex(R"(\\begin\{([^}]+)\})");
-    QRegularExpression endRegex(R"(\\end\{([^}]+)\})");
+    ScanState state;
+    scan(content, 0, 0, state, errors, lineStarted);
+    // What is still open where the check stopped may be closed further down
+    if (!stopped) {
+        finishDocument(state, errors);
+    }
 
-    QStringList lines = content.split('\n');
+    std::stable_sort(errors.begin(), errors.end(), errorBefore);
+    const qsizetype found = errors.size();
+    truncateErrors(errors, m_limits.maxErrors);
+    if (complete) {
+        *complete = !stopped && errors.size() == found;
+    }
+    return errors;
+}
 
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
+LaTeXErrorChecker::CheckStatus LaTeXErrorChecker::checkIncremental(const QString &content, QVector<LaTeXError> &errors,
+                                                                   const std::function<bool()> &isCancelled,
+                                                                   int pauseAfterLine) {
+    ScopedTimer totalTimer("Errors: total");
+    RuleTimingScope ruleTimings(*this);
+    QElapsedTimer timer;
+    timer.start();
+
+    // Only the text between the common prefix and suffix of the two versions changed
+    const QStringView oldContent = m_content;
+    const QStringView newContent = content;
+    const qsizetype prefix = m_lines.isEmpty() ? 0 : commonPrefixLength(oldContent, newContent);
+    const qsizetype suffix = m_lines.isEmpty() ? 0
+        : commonSuffixLength(oldContent.mid(prefix), newContent.mid(prefix));
+    const qsizetype newSuffixStart = newContent.size() - suffix;
+    const qsizetype charDelta = newContent.size() - oldContent.size();
+    // A paused check continues even if the text did not change
+    const bool unchanged = m_complete && prefix == oldContent.size() && prefix == newContent.size();
+
+    if (!unchanged) {
+        // Resume at the last checkpoint before the first change
+        int resumeLine = 0;
+        if (!m_lines.isEmpty()) {
+            const auto after = std::upper_bound(m_lines.cbegin(), m_lines.cend(), prefix,
+                [](qsizetype position, const LineCheckpoint &line) { return position < line.start; });
+            resumeLine = std::max(0, static_cast<int>(after - m_lines.cbegin()) - 1);
+            while (resumeLine > 0 && !m_lines[resumeLine].resumable) {
+                --resumeLine;
+            }
+        }
 
-        // Check for \begin
-        QRegularExpressionMatchIterator beginIt = beginRegex.globalMatch(line);
-        while (beginIt.hasNext()) {
-            QRegularExpressionMatch match = beginIt.next();
-            if (!isInComment(line, match.capturedStart())) {
-                QString envName = match.captured(1);
-                envStack.push({envName, lineNum, static_cast<int>(match.capturedStart())});
+        // Old lines that start inside the common suffix move by the line delta
+        const qsizetype oldSuffixStart = oldContent.size() - suffix;
+        const int oldTailLine = static_cast<int>(std::lower_bound(m_lines.cbegin(), m_lines.cend(), oldSuffixStart,
+            [](const LineCheckpoint &line, qsizetype position) { return line.start < position; }) - m_lines.cbegin());
+
+        ScanState state = m_lines.isEmpty() ? ScanState() : m_lines[resumeLine].state;
+        const qsizetype resumeStart = m_lines.isEmpty() ? 0 : m_lines[resumeLine].start;
+
+        // m_errors is sorted by line, so the errors of the rescanned lines are
+        // one range of it
+        auto firstErrorOnLine = [this](int line) {
+            return std::lower_bound(m_errors.cbegin(), m_errors.cend(), line,
+                [](const LaTeXError &error, int line) { return error.line < line; }) - m_errors.cbegin();
+        };
+        const qsizetype replacedFrom = firstErrorOnLine(resumeLine);
+
+        QVector<LineCheckpoint> scanned;
+        scanned.append(LineCheckpoint{resumeStart, true, state});
+        QVector<LaTeXError> scannedErrors;
+        int convergedLine = -1;   // Old line where the scan state matched again
+        int lineDelta = 0;
+        bool cancelled = false;
+        bool paused = false;
+
+        // Adds checkpoints for lines the tokenizer skipped inside raw text
+        auto fillLines = [&](int line) {
+            while (resumeLine + scanned.size() < line) {
+                const qsizetype previousStart = scanned.last().start;
+                const qsizetype newline = newContent.indexOf(u'\n', previousStart);
+                scanned.append(LineCheckpoint{newline < 0 ? newContent.size() : newline + 1, false, {}});
             }
+        };
+
+        scan(content, resumeStart, resumeLine, state, scannedErrors,
+             [&](int line, qsizetype start, const ScanState &current) {
+                 if (isCancelled && line % CancelCheckInterval == 0 && isCancelled()) {
+                     cancelled = true;
+                     return false;
+                 }
+                 fillLines(line);
+
+                 // Past the edit, stop as soon as the state is the one the old
+                 // run had at the same text
+                 if (start >= newSuffixStart) {
+                     const qsizetype oldStart = start - charDelta;
+                     const auto old = std::lower_bound(m_lines.cbegin(), m_lines.cend(), oldStart,
+                         [](const LineCheckpoint &checkpoint, qsizetype position) { return checkpoint.start < position; });
+                     if (old != m_lines.cend() && old->start == oldStart && old->resumable) {
+                         const int oldLine = static_cast<int>(old - m_lines.cbegin());
+                         if (sameState(current, old->state, oldTailLine, line - oldLine)) {
+                             convergedLine = oldLine;
+                             lineDelta = line - oldLine;
+                             return false;
+                         }
+                     }
+                 }
+
+                 scanned.append(LineCheckpoint{start, true, current});
+
+                 // Errors before the resumed line stay, those after it are found again
+                 const qsizetype errorCount = replacedFrom + scannedErrors.size();
+                 if ((pauseAfterLine >= resumeLine && line > pauseAfterLine)
+                     || limitReached(m_limits, timer, errorCount, line)) {
+                     paused = true;
+                     return false;
+                 }
+                 return true;
+             });
+
+        if (cancelled) {
+            return CheckStatus::Cancelled;
         }
 
-        // Check for \end
-        QRegularExpressionMatchIterator endIt = endRegex.globalMatch(line);
-        while (endIt.hasNext()) {
-            QRegularExpressionMatch match = endIt.next();
-            if (!isInComment(line, match.capturedStart())) {
-                QString envName = match.captured(1);
-
-                if (envStack.isEmpty()) {
-                    errors.append(LaTeXError(
-                        LaTeXError::UnmatchedEnvironment,
-                        lineNum,
-                        static_cast<int>(match.capturedStart()),
-                        QString("Unmatched \\end{%1}").arg(envName),
-                        match.captured(0)
-                    ));
-                } else {
-                    EnvironmentInfo info = envStack.pop();
-                    if (info.name != envName) {
-                        errors.append(LaTeXError(
-                            LaTeXError::UnmatchedEnvironment,
-                            lineNum,
-                            static_cast<int>(match.capturedStart()),
-                            QString("Environment mismatch: expected \\end{%1} but found \\end{%2}")
-                                .arg(info.name, envName),
-                            match.captured(0)
-                        ));
-                        // Push it back since it wasn't the right match
-                        envStack.push(info);
+        std::stable_sort(scannedErrors.begin(), scannedErrors.end(), errorBefore);
+
+        if (paused) {
+            // Keep the lines checked so far; the next call resumes at the last one
+            m_lines.resize(resumeLine);
+            m_lines.append(std::move(scanned));
+            m_errors.remove(replacedFrom, m_errors.size() - replacedFrom);
+            m_errors.append(std::move(scannedErrors));
+            m_complete = false;
+        } else if (convergedLine < 0) {
+            // Reached the end of the document
+            int lastLine = resumeLine + static_cast<int>(scanned.size()) - 1;
+            for (qsizetype pos = scanned.last().start; (pos = newContent.indexOf(u'\n', pos)) >= 0; ++pos) {
+                ++lastLine;
+            }
+            fillLines(lastLine + 1);
+
+            m_lines.resize(resumeLine);
+            m_lines.append(std::move(scanned));
+            m_errors.remove(replacedFrom, m_errors.size() - replacedFrom);
+            m_errors.append(std::move(scannedErrors));
+            m_finalState = state;
+            m_complete = true;
+        } else {
+            // Reuse the unchanged tail, moved to its new position
+            const qsizetype replacedTo = firstErrorOnLine(convergedLine);
+            for (qsizetype i = convergedLine; i < m_lines.size(); ++i) {
+                LineCheckpoint &line = m_lines[i];
+                line.start += charDelta;
+                if (lineDelta != 0 && line.resumable) {
+                    shiftState(line.state, oldTailLine, lineDelta);
+                }
+            }
+            if (lineDelta != 0) {
+                shiftState(m_finalState, oldTailLine, lineDelta);
+                for (qsizetype i = replacedTo; i < m_errors.size(); ++i) {
+                    LaTeXError &error = m_errors[i];
+                    error.line += lineDelta;
+                    // The line of \begin{document} moves like the checkpoint states
+                    if (error.messageId == LaTeXError::MessageId::UsePackageAfterBeginDocument
+                        && error.number >= oldTailLine) {
+                        error.number += lineDelta;
                     }
                 }
             }
+
+            // Replace the rescanned lines and their errors in place
+            replaceRange(m_lines, resumeLine, convergedLine, std::move(scanned));
+            replaceRange(m_errors, replacedFrom, replacedTo, std::move(scannedErrors));
         }
+
+        m_content = content;
     }
 
-    // Report unclosed environments
-    while (!envStack.isEmpty()) {
-        EnvironmentInfo info = envStack.pop();
-        errors.append(LaTeXError(
-            LaTeXError::UnmatchedEnvironment,
-            info.line,
-            info.column,
-            QString("Unclosed environment: \\begin{%1}").arg(info.name),
-            QString("\\begin{%1}").arg(info.name)
-        ));
+    // Shares the stored errors; only errors about the end of the document
+    // and the error limit make a copy
+    errors = m_errors;
+    if (m_complete) {
+        QVector<LaTeXError> documentErrors;
+        ScanState finalState = m_finalState;
+        finishDocument(finalState, documentErrors);
+        if (!documentErrors.isEmpty()) {
+            std::stable_sort(documentErrors.begin(), documentErrors.end(), errorBefore);
+            const qsizetype middle = errors.size();
+            errors.append(documentErrors);
+            std::inplace_merge(errors.begin(), errors.begin() + middle, errors.end(), errorBefore);
+        }
     }
+    truncateErrors(errors, m_limits.maxErrors);
 
-    return errors;
+    // A check stopped by the error limit would only find more errors
+    if (!m_complete && (m_limits.maxErrors <= 0 || m_errors.size() < m_limits.maxErrors)) {
+        return CheckStatus::Paused;
+    }
+    return CheckStatus::Complete;
 }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkMathDelimiters(const QString &content) {
-    QVector<LaTeXError> errors;
+QString LaTeXErrorChecker::ruleName(Rule rule) {
+    return rule < RuleCount ? QLatin1String(RuleNames[rule]) : QString();
+}
 
-    QStringList lines = content.split('\n');
+LaTeXErrorChecker::Rule LaTeXErrorChecker::ruleFromName(const QString &name) {
+    for (int rule = 0; rule < RuleCount; ++rule) {
+        if (name == QLatin1String(RuleNames[rule])) {
+            return static_cast<Rule>(rule);
+        }
+    }
+    return RuleCount;
+}
 
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
+LaTeXErrorChecker::Rule LaTeXErrorChecker::ruleOf(LaTeXError::MessageId messageId) {
+    using MessageId = LaTeXError::MessageId;
+    switch (messageId) {
+        case MessageId::UnmatchedClosingBrace:
+        case MessageId::UnclosedBrace:
+        case MessageId::UnclosedBracket:
+            return BraceRule;
+        case MessageId::UnmatchedEnd:
+        case MessageId::EnvironmentMismatch:
+        case MessageId::UnclosedEnvironment:
+            return EnvironmentRule;
+        case MessageId::UnmatchedInlineMath:
+        case MessageId::UnmatchedDisplayMath:
+        case MessageId::UnmatchedDollar:
+            return MathDelimiterRule;
+        case MessageId::MissingSpaceAfterCommand: return CommandSpacingRule;
+        case MessageId::UsePackageAfterBeginDocument: return PackageOrderRule;
+        case MessageId::UnknownCommand: return UnknownCommandRule;
+        case MessageId::ArgumentCount: return ArgumentCountRule;
+        case MessageId::MathOnlyCommand: return MathModeRule;
+        case MessageId::PackageRequired: return MissingPackageRule;
+        case MessageId::DeprecatedCommand: return DeprecatedCommandRule;
+        case MessageId::MultipleSpaces: return MultipleSpacesRule;
+        case MessageId::BareMathExpression: return BareMathRule;
+        case MessageId::LineBreakOutsideTable: return LineBreakRule;
+    }
+    return RuleCount;
+}
 
-        int dollarCount = 0;
-        int doubleDollarCount = 0;
+void LaTeXErrorChecker::setRuleEnabled(Rule rule, bool enabled) {
+    if (rule >= RuleCount || isRuleEnabled(rule) == enabled) {
+        return;
+    }
+    m_disabledRules ^= 1u << rule;
+    // Stored results were found with the old rules
+    clearIncrementalState();
+}
 
-        for (int col = 0; col < line.length(); ++col) {
-            if (isInComment(line, col)) {
-                break;
-            }
+QVector<LaTeXErrorChecker::RuleStats> LaTeXErrorChecker::ruleStats() const {
+    return QVector<RuleStats>(std::begin(m_ruleStats), std::end(m_ruleStats));
+}
 
-            // Skip escaped $
-            if (col > 0 && line[col-1] == '\\') {
-                continue;
-            }
+void LaTeXErrorChecker::resetRuleStats() {
+    std::fill(std::begin(m_ruleStats), std::end(m_ruleStats), RuleStats());
+}
+
+QString LaTeXErrorChecker::ruleStatsReport(const QVector<RuleStats> &stats) {
+    QVector<int> order;
+    qint64 totalNanoseconds = 0;
+    for (int rule = 0; rule < stats.size() && rule < RuleCount; ++rule) {
+        order.append(rule);
+        totalNanoseconds += stats[rule].nanoseconds;
+    }
+    std::stable_sort(order.begin(), order.end(), [&stats](int a, int b) {
+        return stats[a].nanoseconds > stats[b].nanoseconds;
+    });
+
+    QString report = QString("%1 %2 %3 %4 %5\n")
+                         .arg("Rule", -20).arg("Runs", 12).arg("Hits", 10).arg("Time (ms)", 12).arg("Share", 7);
+    for (int rule : order) {
+        const RuleStats &entry = stats[rule];
+        const double share = totalNanoseconds > 0 ? 100.0 * entry.nanoseconds / totalNanoseconds : 0.0;
+        report += QString("%1 %2 %3 %4 %5%\n")
+                      .arg(ruleName(static_cast<Rule>(rule)), -20)
+                      .arg(entry.runs, 12)
+                      .arg(entry.hits, 10)
+                      .arg(entry.nanoseconds / 1e6, 12, 'f', 2)
+                      .arg(share, 6, 'f', 1);
+    }
+    return report;
+}
+
+void LaTeXErrorChecker::report(QVector<LaTeXError> &errors, const LaTeXError &error, const QString &file) const {
+    const Rule rule = ruleOf(error.messageId);
+    if (!isRuleEnabled(rule)) {
+        return;
+    }
+    if (m_profiling) {
+        ++m_ruleStats[rule].hits;
+    }
+    errors.append(error);
+    errors.last().file = file;
+}
+
+void LaTeXErrorChecker::clearIncrementalState() {
+    m_content.clear();
+    m_lines.clear();
+    m_errors.clear();
+    m_finalState = ScanState();
+    m_complete = false;
+}
+
+void LaTeXErrorChecker::checkFile(const QString &file, QStringView content, ScanState &state,
+                                  QVector<LaTeXError> &errors, const IncludeCallback &included) const {
+    const qsizetype firstError = errors.size();
+    state.file = file;
+    scan(content, 0, 0, state, errors, {}, included);
+    for (qsizetype i = firstError; i < errors.size(); ++i) {
+        errors[i].file = file;
+    }
+    std::stable_sort(errors.begin() + firstError, errors.end(), errorBefore);
+}
+
+void LaTeXErrorChecker::finishProject(ScanState &state, QVector<LaTeXError> &errors) const {
+    finishDocument(state, errors);
+}
+
+void LaTeXErrorChecker::scan(QStringView content, qsizetype from, int firstLine, ScanState &state,
+                             QVector<LaTeXError> &errors, const LineCallback &lineStarted,
+                             const IncludeCallback &included) const {
+    // Positions below are relative to 'from'
+    content = content.mid(from);
+    LaTeXTokenizer tokenizer(content, firstLine);
+    LineState line;
+    line.line = firstLine;
+
+    for (LaTeXToken token = tokenizer.next(); token.type != LaTeXToken::End; token = tokenizer.next()) {
+        // Raw reads (environment names, verbatim bodies) may skip whole lines
+        if (token.line != line.line) {
+            finishLine(content, line, errors);
+            line = LineState();
+            line.line = token.line;
+            line.start = token.position - token.column;
+        }
 
-            if (line[col] == '$') {
-                // Check for $$
-                if (col + 1 < line.length() && line[col + 1] == '$') {
-                    doubleDollarCount++;
-                    col++; // Skip next $
+        if (!line.sawContent && token.type != LaTeXToken::Newline
+            && !(token.type == LaTeXToken::Text && token.text.trimmed().isEmpty())) {
+            line.sawContent = true;
+            line.commentOnly = token.type == LaTeXToken::Comment;
+        }
+
+        if (state.packageArgument != ScanState::NoPackageArgument) {
+            trackPackageArgument(token, state);
+        }
+
+        switch (token.type) {
+            case LaTeXToken::Command:
+                checkCommand(content, tokenizer, token, state, line, errors, included);
+                break;
+            case LaTeXToken::Text:
+                checkText(content, token, line);
+                break;
+            case LaTeXToken::BeginGroup: {
+                RuleTimer timer(profile(BraceRule));
+                state.braces.push({token.line, token.column, '{', state.file});
+                break;
+            }
+            case LaTeXToken::EndGroup: {
+                RuleTimer timer(profile(BraceRule));
+                if (state.braces.isEmpty()) {
+                    report(errors, LaTeXError(
+                        LaTeXError::UnmatchedBrace,
+                        LaTeXError::MessageId::UnmatchedClosingBrace,
+                        token.line,
+                        token.column,
+                        1
+                    ));
                 } else {
-                    dollarCount++;
+                    state.braces.pop();
                 }
+                break;
+            }
+            case LaTeXToken::BeginOptional: {
+                RuleTimer timer(profile(BraceRule));
+                state.brackets.push({token.line, token.column, '[', state.file});
+                break;
+            }
+            case LaTeXToken::EndOptional: {
+                RuleTimer timer(profile(BraceRule));
+                // Don't report unmatched ] as error since they're often optional
+                if (!state.brackets.isEmpty()) {
+                    state.brackets.pop();
+                }
+                break;
+            }
+            case LaTeXToken::MathShift: {
+                RuleTimer timer(profile(MathDelimiterRule));
+                line.hasDollar = true;
+                ++line.dollarCount;
+                state.inlineDollarMath = !state.inlineDollarMath;
+                break;
             }
+            case LaTeXToken::DisplayMathShift: {
+                RuleTimer timer(profile(MathDelimiterRule));
+                line.hasDollar = true;
+                state.displayDollarMath = !state.displayDollarMath;
+                break;
+            }
+            case LaTeXToken::Alignment:
+                line.hasAlignment = true;
+                break;
+            case LaTeXToken::Newline:
+                // Math cannot continue past a paragraph break
+                if (!line.sawContent) {
+                    state.inlineDollarMath = false;
+                    state.displayDollarMath = false;
+                }
+                if (state.definitionDepth >= 0 && state.braces.size() <= state.definitionDepth) {
+                    state.definitionDepth = -1;
+                }
+                finishLine(content, line, errors);
+                line = LineState();
+                line.line = token.line + 1;
+                line.start = token.position + 1;
+                if (lineStarted && !lineStarted(line.line, from + line.start, state)) {
+                    return;
+                }
+                break;
+            case LaTeXToken::Comment:
+            case LaTeXToken::End:
+                break;
+        }
+    }
+
+    finishLine(content, line, errors);
+}
+
+void LaTeXErrorChecker::checkCommand(QStringView content, LaTeXTokenizer &tokenizer, const LaTeXToken &token,
+                                     ScanState &state, LineState &line, QVector<LaTeXError> &errors,
+                                     const IncludeCallback &included) const {
+    const QStringView name = token.text;
+    if (name.isEmpty()) {
+        return;
+    }
+
+    // Control symbols
+    if (name.size() == 1 && !name[0].isLetter()) {
+        // Only math delimiters and line breaks are checked; escapes such as
+        // \{ and \% are not counted against any rule
+        RuleStats *stats = nullptr;
+        switch (name[0].unicode()) {
+            case '(': case ')': case '[': case ']': case '$': stats = profile(MathDelimiterRule); break;
+            case '\\': stats = profile(LineBreakRule); break;
+            default: return;
         }
+        RuleTimer timer(stats);
+        switch (name[0].unicode()) {
+            case '(': ++state.inlineMathBalance; break;
+            case ')': --state.inlineMathBalance; break;
+            case '[': ++state.displayMathBalance; break;
+            case ']': --state.displayMathBalance; break;
+            case '$': line.hasDollar = true; break;
+            case '\\':
+                if (line.lineBreakColumn < 0) {
+                    line.lineBreakColumn = token.column;
+                }
+                break;
+            default: break;
+        }
+        return;
+    }
 
-        // Single $ should appear in pairs on same line
-        if (dollarCount % 2 != 0) {
-            errors.append(LaTeXError(
-                LaTeXError::UnmatchedMathDelimiter,
-                lineNum,
-                0,
-                "Unmatched math delimiter '$' (inline math must be closed on same line)",
-                line
+    // A command glued to a preceding word, such as "the\LaTeX"
+    const qsizetype nameEnd = token.position + 1 + name.size();
+    if (isRuleEnabled(CommandSpacingRule)) {
+        RuleTimer timer(profile(CommandSpacingRule));
+        if (token.column > 0 && isWordChar(content[token.position - 1])
+            && (name.size() > 1 || (nameEnd < content.size() && isWordChar(content[nameEnd])))) {
+            report(errors, LaTeXError(
+                LaTeXError::InvalidCommand,
+                LaTeXError::MessageId::MissingSpaceAfterCommand,
+                token.line,
+                token.column - 1,
+                static_cast<int>(content.mid(token.position - 1, name.size() + 2).size()),
+                name.toString()
             ));
         }
     }
 
-    // Check for \( \) and \[ \] delimiters
-    QRegularExpression mathOpenParen(R"(\\\()");
-    QRegularExpression mathCloseParen(R"(\\\))");
-    QRegularExpression mathOpenBracket(R"(\\\[)");
-    QRegularExpression mathCloseBracket(R"(\\\])");
+    if (name == u"begin" || name == u"end") {
+        RuleTimer timer(profile(EnvironmentRule));
+        const LaTeXTokenizer::Mark start = tokenizer.mark();
+        QStringView environment;
+        if (!tokenizer.readGroup(environment) || environment.isEmpty() || environment.contains(u'\n')) {
+            tokenizer.reset(start);
+            return;
+        }
+        line.hasEnvironment = true;
+        const QString envName = environment.toString();
 
-    int parenBalance = 0;
-    int bracketBalance = 0;
+        if (name == u"begin") {
+            if (envName == QLatin1String("document")) {
+                state.beginDocumentLine = token.line;
+            }
+            state.environments.push({envName, token.line, token.column, state.file});
 
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
+            // Verbatim bodies are not LaTeX; skip to the end marker
+            if (LaTeXBlockSplitter::isVerbatimEnvironment(environment)) {
+                QStringView body;
+                if (tokenizer.readUntil(QString("\\end{%1}").arg(envName), body)) {
+                    state.environments.pop();
+                }
+            }
+            return;
+        }
 
-        parenBalance += line.count(mathOpenParen);
-        parenBalance -= line.count(mathCloseParen);
+        if (state.environments.isEmpty()) {
+            report(errors, LaTeXError(
+                LaTeXError::UnmatchedEnvironment,
+                LaTeXError::MessageId::UnmatchedEnd,
+                token.line,
+                token.column,
+                static_cast<int>(envName.size()) + 6,
+                envName
+            ));
+        } else if (state.environments.top().name != envName) {
+            // Keep the open environment, the \end may just be misspelled
+            report(errors, LaTeXError(
+                LaTeXError::UnmatchedEnvironment,
+                LaTeXError::MessageId::EnvironmentMismatch,
+                token.line,
+                token.column,
+                static_cast<int>(envName.size()) + 6,
+                state.environments.top().name,
+                envName
+            ));
+        } else {
+            state.environments.pop();
+        }
+        return;
+    }
 
-        bracketBalance += line.count(mathOpenBracket);
-        bracketBalance -= line.count(mathCloseBracket);
+    if (name == u"usepackage") {
+        RuleTimer timer(profile(PackageOrderRule));
+        if (state.beginDocumentLine >= 0) {
+            report(errors, LaTeXError(
+                LaTeXError::UsePackageAfterBeginDocument,
+                LaTeXError::MessageId::UsePackageAfterBeginDocument,
+                token.line,
+                token.column,
+                static_cast<int>(lineText(content, line.start).trimmed().size()),
+                QString(),
+                QString(),
+                state.beginDocumentLine
+            ));
+        }
+
+        // The arguments are collected token by token, so no state depends on later lines
+        state.packageArgument = ScanState::ExpectPackageOptions;
+        state.documentClassArgument = false;
+        return;
     }
 
-    if (parenBalance != 0) {
-        errors.append(LaTeXError(
-            LaTeXError::UnmatchedMathDelimiter,
-            0,
-            0,
-            QString("Unmatched math delimiters \\( \\): %1 %2")
-                .arg(parenBalance > 0 ? "unclosed" : "extra closing")
-                .arg(qAbs(parenBalance)),
-            ""
-        ));
+    if (name == u"documentclass") {
+        state.packageArgument = ScanState::ExpectPackageOptions;
+        state.documentClassArgument = true;
+        return;
     }
 
-    if (bracketBalance != 0) {
-        errors.append(LaTeXError(
-            LaTeXError::UnmatchedMathDelimiter,
-            0,
-            0,
-            QString("Unmatched math delimiters \\[ \\]: %1 %2")
-                .arg(bracketBalance > 0 ? "unclosed" : "extra closing")
-                .arg(qAbs(bracketBalance)),
-            ""
-        ));
+    if (name == u"verb") {
+        line.hasVerb = true;
+        QStringView verbatim;
+        tokenizer.skipChar(QLatin1Char('*'));
+        tokenizer.readDelimited(verbatim);
+        return;
     }
 
-    return errors;
-}
+    LaTeXCommandInfo info;
+    const bool known = m_commands.lookup(name, info);
 
-void LaTeXErrorChecker::initializeCommandDatabase() {
-    // Math mode commands
-    m_mathCommands = {
-        "frac", "sqrt", "sum", "int", "prod", "lim",
-        "alpha", "beta", "gamma", "delta", "epsilon",
-        "theta", "lambda", "mu", "pi", "sigma", "omega",
-        "infty", "partial", "nabla", "forall", "exists",
-        "leq", "geq", "neq", "approx", "equiv",
-        "times", "cdot", "pm", "mp"
-    };
+    if (isDefinitionCommand(name) || (known && (info.flags & LaTeXCommandInfo::Definition))) {
+        if (state.definitionDepth < 0) {
+            state.definitionDepth = static_cast<int>(state.braces.size());
+        }
 
-    // Deprecated commands
-    m_deprecatedCommands = {
-        "bf", "it", "rm", "sf", "tt", "sc",
-        "over", "atop", "above", "choose"
-    };
+        // Remember the defined name, as in \newcommand*{\name} or \def\name. Only
+        // the same line is looked at, so no result depends on later lines.
+        if (name != u"ensuremath") {
+            const LaTeXTokenizer::Mark start = tokenizer.mark();
+            tokenizer.beginGroup(true);
+            tokenizer.skipWhitespace();
+            const LaTeXToken defined = tokenizer.next();
+            if (defined.type == LaTeXToken::Command && !defined.text.isEmpty() && defined.line == token.line) {
+                state.definedCommands.insert(defined.text.toString());
+            }
+            tokenizer.reset(start);
+        }
+    } else if (isInputCommand(name)) {
+        // In a project the included file is checked from here on; otherwise
+        // anything it defines is unknown
+        QStringView fileName;
+        const LaTeXTokenizer::Mark start = tokenizer.mark();
+        if (included && name != u"import" && name != u"subimport" && name != u"InputIfFileExists"
+            && tokenizer.readGroup(fileName) && !fileName.trimmed().isEmpty() && !fileName.contains(u'\n')) {
+            const QString file = state.file;
+            included(fileName.trimmed().toString(), state);
+            state.file = file;
+        } else {
+            state.externalDefinitions = true;
+        }
+        tokenizer.reset(start);
+    }
+
+    if (!known) {
+        // Only the body is checked; preambles are full of low-level definitions
+        if (isRuleEnabled(UnknownCommandRule)) {
+            RuleTimer timer(profile(UnknownCommandRule));
+            if (m_commands.isComplete() && state.beginDocumentLine >= 0 && state.definitionDepth < 0
+                && !state.externalDefinitions) {
+                const QString command = name.toString();
+                if (!state.definedCommands.contains(command)) {
+                    report(errors, LaTeXError(
+                        LaTeXError::UnknownCommand,
+                        LaTeXError::MessageId::UnknownCommand,
+                        token.line,
+                        token.column,
+                        static_cast<int>(name.size()) + 1,
+                        command
+                    ));
+                }
+            }
+        }
+        return;
+    }
 
-    // Package-specific commands
-    m_packageCommands = {
-        {"includegraphics", "graphicx"},
-        {"url", "url"},
-        {"href", "hyperref"},
-        {"cite", "natbib"},
-        {"citep", "natbib"},
-        {"citet", "natbib"},
-        {"textcolor", "xcolor"},
-        {"definecolor", "xcolor"},
-        {"listings", "listings"},
-        {"lstlisting", "listings"}
+    // The strings of a known command live in the shared table, which is never
+    // unloaded, so errors refer to them instead of copying them
+    const int commandLength = static_cast<int>(name.size()) + 1;
+    auto tableString = [](QStringView text) {
+        return QString::fromRawData(reinterpret_cast<const QChar *>(text.utf16()), text.size());
     };
-}
 
-void LaTeXErrorChecker::initializePackageDatabase() {
-    // This is already partially done in m_packageCommands
-    // Could be extended with more detailed package information
-}
+    if (info.requiredArgs > 0 && state.definitionDepth < 0 && isRuleEnabled(ArgumentCountRule)) {
+        RuleTimer timer(profile(ArgumentCountRule));
+        if (missingArgument(content, nameEnd, info.requiredArgs)) {
+            report(errors, LaTeXError(
+                LaTeXError::InvalidArgumentCount,
+                LaTeXError::MessageId::ArgumentCount,
+                token.line,
+                token.column,
+                commandLength,
+                tableString(info.name),
+                QString(),
+                info.requiredArgs
+            ));
+        }
+    }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkCommands(const QString &content) {
-    QVector<LaTeXError> errors;
+    if ((info.flags & LaTeXCommandInfo::MathOnly) && state.definitionDepth < 0 && isRuleEnabled(MathModeRule)) {
+        RuleTimer timer(profile(MathModeRule));
+        if (!inMathMode(state)) {
+            report(errors, LaTeXError(
+                LaTeXError::MathModeRequired,
+                LaTeXError::MessageId::MathOnlyCommand,
+                token.line,
+                token.column,
+                commandLength,
+                tableString(info.name)
+            ));
+        }
+    }
 
-    QRegularExpression cmdRegex(R"(\\([a-zA-Z]+))");
-    QStringList lines = content.split('\n');
-
-    // Track if we have loaded packages
-    QSet<QString> loadedPackages;
-    QRegularExpression usepackageRegex(R"(\\usepackage(?:\[[^\]]*\])?\{([^}]+)\})");
-
-    // First pass: collect loaded packages
-    for (const QString &line : lines) {
-        QRegularExpressionMatchIterator it = usepackageRegex.globalMatch(line);
-        while (it.hasNext()) {
-            QRegularExpressionMatch match = it.next();
-            QString packages = match.captured(1);
-            for (const QString &pkg : packages.split(',')) {
-                loadedPackages.insert(pkg.trimmed());
+    // Commands that need a package loaded before they are used; any of several will do
+    if (!info.package.isEmpty() && isRuleEnabled(MissingPackageRule)) {
+        RuleTimer timer(profile(MissingPackageRule));
+        bool loaded = false;
+        for (QStringView package : info.package.split(u',')) {
+            if (state.loadedPackages.contains(package.toString())) {
+                loaded = true;
+                break;
             }
         }
+        if (!loaded) {
+            report(errors, LaTeXError(
+                LaTeXError::MissingPackage,
+                LaTeXError::MessageId::PackageRequired,
+                token.line,
+                token.column,
+                commandLength,
+                tableString(info.name),
+                tableString(info.package)
+            ));
+        }
     }
 
-    // Second pass: check commands
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
-
-        QRegularExpressionMatchIterator it = cmdRegex.globalMatch(line);
-        while (it.hasNext()) {
-            QRegularExpressionMatch match = it.next();
+    if (info.flags & LaTeXCommandInfo::Deprecated) {
+        RuleTimer timer(profile(DeprecatedCommandRule));
+        report(errors, LaTeXError(
+            LaTeXError::DeprecatedCommand,
+            LaTeXError::MessageId::DeprecatedCommand,
+            token.line,
+            token.column,
+            commandLength,
+            tableString(info.name),
+            tableString(info.replacement)
+        ));
+    }
+}
 
-            if (isInComment(line, match.capturedStart())) {
-                continue;
+void LaTeXErrorChecker::trackPackageArgument(const LaTeXToken &token, ScanState &state) const {
+    const bool blank = token.type == LaTeXToken::Newline || token.type == LaTeXToken::Comment
+        || (token.type == LaTeXToken::Text && token.text.trimmed().isEmpty());
+
+    switch (state.packageArgument) {
+        case ScanState::ExpectPackageOptions:
+        case ScanState::ExpectPackageList:
+            if (token.type == LaTeXToken::BeginOptional && state.packageArgument == ScanState::ExpectPackageOptions) {
+                state.packageArgument = ScanState::InPackageOptions;
+            } else if (token.type == LaTeXToken::BeginGroup) {
+                state.packageArgument = ScanState::InPackageList;
+                state.packageListDepth = static_cast<int>(state.braces.size()) + 1;
+                state.packageList.clear();
+            } else if (!blank) {
+                state.packageArgument = ScanState::NoPackageArgument;
+                state.documentClassArgument = false;
             }
+            break;
+        case ScanState::InPackageOptions:
+            if (token.type == LaTeXToken::EndOptional) {
+                state.packageArgument = ScanState::ExpectPackageList;
+            }
+            break;
+        case ScanState::InPackageList:
+            if (token.type == LaTeXToken::Text) {
+                state.packageList += token.text;
+            } else if (token.type == LaTeXToken::EndGroup && state.braces.size() == state.packageListDepth) {
+                for (QStringView package : QStringView(state.packageList).split(u',')) {
+                    package = package.trimmed();
+                    if (!state.documentClassArgument) {
+                        loadPackage(package.toString(), state);
+                        continue;
+                    }
 
-            QString cmdName = match.captured(1);
-
-            // Check if command requires a package
-            if (m_packageCommands.contains(cmdName)) {
-                QString requiredPackage = m_packageCommands[cmdName];
-                if (!loadedPackages.contains(requiredPackage)) {
-                    errors.append(LaTeXError(
-                        LaTeXError::MissingPackage,
-                        lineNum,
-                        match.capturedStart(),
-                        QString("Command \\%1 requires package '%2'").arg(cmdName, requiredPackage),
-                        match.captured(0)
-                    ));
+                    // Classes are word lists too; the standard ones only use kernel commands
+                    QString className = QLatin1String("class-");
+                    className += package;
+                    QStringView includes;
+                    if (m_commands.findPackage(className, includes)) {
+                        loadPackage(className, state);
+                    } else if (!isStandardClass(package)) {
+                        state.externalDefinitions = true;
+                    }
                 }
+                state.packageList.clear();
+                state.packageArgument = ScanState::NoPackageArgument;
+                state.documentClassArgument = false;
             }
+            break;
+        case ScanState::NoPackageArgument:
+            break;
+    }
+}
 
-            // Check deprecated commands
-            if (m_deprecatedCommands.contains(cmdName)) {
-                QString replacement;
-                if (cmdName == "bf") replacement = "\\textbf{} or \\bfseries";
-                else if (cmdName == "it") replacement = "\\textit{} or \\itshape";
-                else if (cmdName == "rm") replacement = "\\textrm{} or \\rmfamily";
-                else if (cmdName == "tt") replacement = "\\texttt{} or \\ttfamily";
-                else if (cmdName == "sc") replacement = "\\textsc{} or \\scshape";
-                else if (cmdName == "sf") replacement = "\\textsf{} or \\sffamily";
-                else replacement = "(see LaTeX documentation)";
-
-                errors.append(LaTeXError(
-                    LaTeXError::DeprecatedCommand,
-                    lineNum,
-                    match.capturedStart(),
-                    QString("Deprecated command \\%1, use %2 instead").arg(cmdName, replacement),
-                    match.captured(0)
-                ));
+void LaTeXErrorChecker::loadPackage(const QString &package, ScanState &state) const {
+    if (package.isEmpty() || state.loadedPackages.contains(package)) {
+        return;
+    }
+    state.loadedPackages.insert(package);
+
+    // Packages loaded by this one are available as well
+    QStringView includes;
+    if (!m_commands.findPackage(package, includes)) {
+        state.externalDefinitions = true;
+        return;
+    }
+    for (QStringView include : includes.split(u',', Qt::SkipEmptyParts)) {
+        loadPackage(include.toString(), state);
+    }
+}
+
+bool LaTeXErrorChecker::inMathMode(const ScanState &state) {
+    if (state.inlineDollarMath || state.displayDollarMath
+        || state.inlineMathBalance > 0 || state.displayMathBalance > 0) {
+        return true;
+    }
+    for (const EnvironmentInfo &environment : state.environments) {
+        if (isMathEnvironment(environment.name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LaTeXErrorChecker::checkText(QStringView content, const LaTeXToken &token, LineState &line) const {
+    if (line.doubleSpaceColumn < 0 && isRuleEnabled(MultipleSpacesRule)) {
+        RuleTimer timer(profile(MultipleSpacesRule));
+        const qsizetype pos = token.text.indexOf(u"  ");
+        if (pos >= 0) {
+            line.doubleSpaceColumn = token.column + static_cast<int>(pos);
+        }
+    }
+
+    if (line.mathExpressionColumn < 0 && isRuleEnabled(BareMathRule)) {
+        RuleTimer timer(profile(BareMathRule));
+        // Match against the whole line so word boundaries see the previous token
+        const QStringView lineView = content.mid(line.start);
+        const qsizetype tokenStart = token.position - line.start;
+        for (qsizetype i = 0; i < token.text.size(); ++i) {
+            const qsizetype length = matchBareComparison(lineView.left(tokenStart + token.text.size()), tokenStart + i);
+            if (length > 0) {
+                line.mathExpressionColumn = token.column + static_cast<int>(i);
+                line.mathExpressionLength = static_cast<int>(length);
+                break;
             }
         }
     }
+}
 
-    return errors;
+void LaTeXErrorChecker::finishLine(QStringView content, const LineState &line, QVector<LaTeXError> &errors) const {
+    // Single $ should appear in pairs on same line
+    if (line.dollarCount % 2 != 0) {
+        report(errors, LaTeXError(
+            LaTeXError::UnmatchedMathDelimiter,
+            LaTeXError::MessageId::UnmatchedDollar,
+            line.line,
+            0,
+            static_cast<int>(lineText(content, line.start).size())
+        ));
+    }
+
+    // Double spaces are a common typo, but not in verbatim text or comments
+    if (line.doubleSpaceColumn >= 0 && !line.hasVerb && !line.commentOnly) {
+        report(errors, LaTeXError(
+            LaTeXError::InvalidCommand,
+            LaTeXError::MessageId::MultipleSpaces,
+            line.line,
+            line.doubleSpaceColumn,
+            2
+        ));
+    }
+
+    // A bare comparison such as "x = 5" on a line without any math
+    if (line.mathExpressionColumn >= 0 && !line.hasDollar) {
+        report(errors, LaTeXError(
+            LaTeXError::MathModeRequired,
+            LaTeXError::MessageId::BareMathExpression,
+            line.line,
+            line.mathExpressionColumn,
+            line.mathExpressionLength
+        ));
+    }
+
+    // \\ on a line that is unlikely to be a table row
+    if (line.lineBreakColumn >= 0 && !line.hasEnvironment && !line.hasAlignment) {
+        report(errors, LaTeXError(
+            LaTeXError::InvalidCommand,
+            LaTeXError::MessageId::LineBreakOutsideTable,
+            line.line,
+            line.lineBreakColumn,
+            2
+        ));
+    }
 }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkPackages(const QString &content) {
-    QVector<LaTeXError> errors;
+void LaTeXErrorChecker::finishDocument(ScanState &state, QVector<LaTeXError> &errors) const {
+    // Report unclosed braces
+    while (!state.braces.isEmpty()) {
+        BraceInfo info = state.braces.pop();
+        report(errors, LaTeXError(
+            LaTeXError::UnmatchedBrace,
+            LaTeXError::MessageId::UnclosedBrace,
+            info.line,
+            info.column,
+            1
+        ), info.file);
+    }
 
-    QStringList lines = content.split('\n');
-    bool foundBeginDocument = false;
-    int beginDocumentLine = -1;
+    // Report unclosed brackets
+    while (!state.brackets.isEmpty()) {
+        BraceInfo info = state.brackets.pop();
+        report(errors, LaTeXError(
+            LaTeXError::UnmatchedBracket,
+            LaTeXError::MessageId::UnclosedBracket,
+            info.line,
+            info.column,
+            1
+        ), info.file);
+    }
 
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
+    // Report unclosed environments
+    while (!state.environments.isEmpty()) {
+        EnvironmentInfo info = state.environments.pop();
+        report(errors, LaTeXError(
+            LaTeXError::UnmatchedEnvironment,
+            LaTeXError::MessageId::UnclosedEnvironment,
+            info.line,
+            info.column,
+            static_cast<int>(info.name.size()) + 8,
+            info.name
+        ), info.file);
+    }
 
-        if (line.contains(QRegularExpression(R"(\\begin\{document\})"))) {
-            foundBeginDocument = true;
-            beginDocumentLine = lineNum;
-        }
+    if (state.inlineMathBalance != 0) {
+        report(errors, LaTeXError(
+            LaTeXError::UnmatchedMathDelimiter,
+            LaTeXError::MessageId::UnmatchedInlineMath,
+            0,
+            0,
+            0,
+            QString(),
+            QString(),
+            state.inlineMathBalance
+        ), state.file);
+    }
 
-        // Check for \usepackage after \begin{document}
-        if (foundBeginDocument && line.contains(QRegularExpression(R"(\\usepackage)"))) {
-            if (!isInComment(line, line.indexOf("\\usepackage"))) {
-                errors.append(LaTeXError(
-                    LaTeXError::UsePackageAfterBeginDocument,
-                    lineNum,
-                    line.indexOf("\\usepackage"),
-                    QString("\\usepackage must be used before \\begin{document} (line %1)").arg(beginDocumentLine + 1),
-                    line.trimmed()
-                ));
-            }
-        }
+    if (state.displayMathBalance != 0) {
+        report(errors, LaTeXError(
+            LaTeXError::UnmatchedMathDelimiter,
+            LaTeXError::MessageId::UnmatchedDisplayMath,
+            0,
+            0,
+            0,
+            QString(),
+            QString(),
+            state.displayMathBalance
+        ), state.file);
     }
+}
 
-    return errors;
+bool LaTeXErrorChecker::sameState(const ScanState &current, const ScanState &previous) {
+    return sameState(current, previous, std::numeric_limits<int>::max(), 0);
 }
 
-QVector<LaTeXError> LaTeXErrorChecker::checkCommonMistakes(const QString &content) {
-    QVector<LaTeXError> errors;
+bool LaTeXErrorChecker::sameState(const ScanState &current, const ScanState &previous, int shiftFrom, int delta) {
+    auto shifted = [shiftFrom, delta](int line) { return line >= shiftFrom ? line + delta : line; };
+
+    if (current.braces.size() != previous.braces.size()
+        || current.brackets.size() != previous.brackets.size()
+        || current.environments.size() != previous.environments.size()
+        || current.inlineMathBalance != previous.inlineMathBalance
+        || current.displayMathBalance != previous.displayMathBalance
+        || current.inlineDollarMath != previous.inlineDollarMath
+        || current.displayDollarMath != previous.displayDollarMath
+        || current.definitionDepth != previous.definitionDepth
+        || current.externalDefinitions != previous.externalDefinitions
+        || current.documentClassArgument != previous.documentClassArgument
+        || current.beginDocumentLine != (previous.beginDocumentLine < 0 ? -1 : shifted(previous.beginDocumentLine))
+        || current.packageArgument != previous.packageArgument
+        || current.packageListDepth != previous.packageListDepth
+        || current.packageList != previous.packageList
+        || current.loadedPackages != previous.loadedPackages
+        || current.definedCommands != previous.definedCommands) {
+        return false;
+    }
 
-    QStringList lines = content.split('\n');
-
-    for (int lineNum = 0; lineNum < lines.size(); ++lineNum) {
-        const QString &line = lines[lineNum];
-
-        // Check for common spacing mistakes
-        if (line.contains(QRegularExpression(R"(\w\\\w)"))) {
-            // Missing space after backslash command
-            QRegularExpression pattern(R"(\w(\\[a-zA-Z]+)\w)");
-            QRegularExpressionMatchIterator it = pattern.globalMatch(line);
-            while (it.hasNext()) {
-                QRegularExpressionMatch match = it.next();
-                if (!isInComment(line, match.capturedStart())) {
-                    errors.append(LaTeXError(
-                        LaTeXError::InvalidCommand,
-                        lineNum,
-                        match.capturedStart(),
-                        QString("Missing space or {} after command %1").arg(match.captured(1)),
-                        match.captured(0)
-                    ));
-                }
+    auto sameBraces = [&](const QStack<BraceInfo> &a, const QStack<BraceInfo> &b) {
+        for (qsizetype i = 0; i < a.size(); ++i) {
+            if (a[i].line != shifted(b[i].line) || a[i].column != b[i].column || a[i].file != b[i].file) {
+                return false;
             }
         }
+        return true;
+    };
+    if (!sameBraces(current.braces, previous.braces) || !sameBraces(current.brackets, previous.brackets)) {
+        return false;
+    }
 
-        // Check for double spaces (common typo)
-        if (line.contains("  ") && !isInComment(line, line.indexOf("  "))) {
-            int pos = line.indexOf("  ");
-            // Only warn if not in verbatim-like content
-            if (!line.contains("\\verb") && !line.trimmed().startsWith("%")) {
-                errors.append(LaTeXError(
-                    LaTeXError::InvalidCommand,
-                    lineNum,
-                    pos,
-                    "Multiple consecutive spaces (LaTeX ignores extra spaces, but this may be unintentional)",
-                    "  "
-                ));
-            }
+    for (qsizetype i = 0; i < current.environments.size(); ++i) {
+        const EnvironmentInfo &a = current.environments[i];
+        const EnvironmentInfo &b = previous.environments[i];
+        if (a.line != shifted(b.line) || a.column != b.column || a.name != b.name || a.file != b.file) {
+            return false;
         }
+    }
+    return true;
+}
 
-        // Check for missing $ in common math expressions
-        QRegularExpression mathPattern(R"(\b(?:x|y|z|n|i|j|k)\s*[=<>]\s*\d+\b)");
-        if (!line.contains('$') && mathPattern.match(line).hasMatch()) {
-            QRegularExpressionMatch match = mathPattern.match(line);
-            if (!isInComment(line, match.capturedStart())) {
-                errors.append(LaTeXError(
-                    LaTeXError::MathModeRequired,
-                    lineNum,
-                    match.capturedStart(),
-                    "Mathematical expression should be in math mode ($...$)",
-                    match.captured(0)
-                ));
+void LaTeXErrorChecker::shiftState(ScanState &state, int shiftFrom, int delta) {
+    // Only touch (and detach) the stacks that hold entries past the edit
+    auto shiftBraces = [shiftFrom, delta](QStack<BraceInfo> &stack) {
+        if (!stack.isEmpty() && stack.top().line >= shiftFrom) {
+            for (BraceInfo &info : stack) {
+                if (info.line >= shiftFrom) {
+                    info.line += delta;
+                }
             }
         }
+    };
+    shiftBraces(state.braces);
+    shiftBraces(state.brackets);
 
-        // Check for \\ outside of tables/arrays
-        if (line.contains(R"(\\)") && !line.contains("\\begin{") && !line.contains("\\end{")) {
-            // Check if we're likely in a table environment
-            bool likelyInTable = line.contains("&");
-            if (!likelyInTable && !isInComment(line, line.indexOf(R"(\\)"))) {
-                int pos = line.indexOf(R"(\\)");
-                errors.append(LaTeXError(
-                    LaTeXError::InvalidCommand,
-                    lineNum,
-                    pos,
-                    "Use of \\\\ outside table/array environment (use \\par or blank line for paragraphs)",
-                    R"(\\)"
-                ));
+    if (!state.environments.isEmpty() && state.environments.top().line >= shiftFrom) {
+        for (EnvironmentInfo &info : state.environments) {
+            if (info.line >= shiftFrom) {
+                info.line += delta;
             }
         }
     }
+    if (state.beginDocumentLine >= shiftFrom) {
+        state.beginDocumentLine += delta;
+    }
+}
 
-    return errors;
+QStringView LaTeXErrorChecker::lineText(QStringView content, qsizetype lineStart) {
+    qsizetype lineEnd = content.indexOf(u'\n', lineStart);
+    if (lineEnd < 0) {
+        lineEnd = content.size();
+    }
+    return content.mid(lineStart, lineEnd - lineStart);
 }
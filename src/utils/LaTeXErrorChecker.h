@@ -4,9 +4,18 @@
 #include <QString>
 #include <QVector>
 #include <QObject>
+#include <QSet>
+#include <QStack>
+#include <functional>
+#include "LaTeXCommandDatabase.h"
+#include "LaTeXTokenizer.h"
 
+// One problem found by the checker. The text is not stored: the message is
+// an ID plus arguments and is only formatted by message(), when shown. Most
+// errors hold no string of their own, so documents with thousands of errors
+// cost no allocation per error.
 struct LaTeXError {
-    enum ErrorType {
+    enum ErrorType : quint8 {
         UnmatchedBrace,
         UnmatchedBracket,
         UnmatchedEnvironment,
@@ -22,15 +31,53 @@ struct LaTeXError {
         TextModeRequired
     };
 
-    ErrorType type;
+    enum Severity : quint8 {
+        Error,
+        Warning,
+        Information
+    };
+
+    // Message templates; %1 and %2 are 'argument' and 'argument2', or 'number'
+    enum class MessageId : quint8 {
+        UnmatchedClosingBrace,
+        UnclosedBrace,
+        UnclosedBracket,
+        UnmatchedEnd,                     // %1 environment
+        EnvironmentMismatch,              // %1 expected, %2 found environment
+        UnclosedEnvironment,              // %1 environment
+        UnmatchedInlineMath,              // number: open \( minus closing \)
+        UnmatchedDisplayMath,             // number: open \[ minus closing \]
+        UnmatchedDollar,
+        MissingSpaceAfterCommand,         // %1 command
+        UsePackageAfterBeginDocument,     // number: line of \begin{document}
+        UnknownCommand,                   // %1 command
+        ArgumentCount,                    // %1 command, number of arguments
+        MathOnlyCommand,                  // %1 command
+        PackageRequired,                  // %1 command, %2 comma-separated packages
+        DeprecatedCommand,                // %1 command, %2 replacement
+        MultipleSpaces,
+        BareMathExpression,
+        LineBreakOutsideTable
+    };
+
     int line;
     int column;
-    QString message;
-    QString context; // The problematic text
+    int length;        // Length of the problematic text
+    int number = 0;
+    ErrorType type;
+    MessageId messageId;
+    QString argument;
+    QString argument2;
+    QString file;      // Project file the error is in, empty for the edited document
 
-    LaTeXError(ErrorType t, int l, int c, const QString &msg, const QString &ctx = "")
-        : type(t), line(l), column(c), message(msg), context(ctx) {}
+    LaTeXError(ErrorType t, MessageId m, int l, int c, int len,
+               const QString &arg = QString(), const QString &arg2 = QString(), int num = 0)
+        : line(l), column(c), length(len), number(num), type(t), messageId(m), argument(arg), argument2(arg2) {}
+
+    QString message() const;
+    Severity severity() const;
 };
+Q_DECLARE_TYPEINFO(LaTeXError, Q_RELOCATABLE_TYPE);
 
 class LaTeXErrorChecker : public QObject {
     Q_OBJECT
@@ -38,48 +85,210 @@ class LaTeXErrorChecker : public QObject {
 public:
     explicit LaTeXErrorChecker(QObject *parent = nullptr);
 
-    QVector<LaTeXError> checkDocument(const QString &content);
+    // Bounds for a single check; 0 means unbounded. A check that runs out of
+    // time or reaches the error limit stops at the end of a line and returns
+    // the errors found so far.
+    struct Limits {
+        int timeBudgetMs = 0;
+        int maxErrors = 0;
+    };
+    void setLimits(const Limits &limits) { m_limits = limits; }
+    const Limits &limits() const { return m_limits; }
+
+    // 'complete' is set to false if the limits cut the check short
+    QVector<LaTeXError> checkDocument(const QString &content, bool *complete = nullptr);
+
+    enum class CheckStatus {
+        Complete,
+        Paused,      // Only lines up to a point were checked; call again to continue
+        Cancelled
+    };
+
+    // Checks a new version of the document passed to the previous call. Only
+    // the lines from the first change up to the point where the scan state
+    // matches the previous run again are scanned; the other results are reused.
+    //
+    // The check pauses when the time budget runs out, or once it has passed
+    // 'pauseAfterLine', so that results for the lines on screen can be shown
+    // first. 'errors' then covers the lines checked so far, and the next call
+    // continues from there, with the same or a newer version of the document.
+    // If 'isCancelled' stops the check, the state of the previous call is kept.
+    CheckStatus checkIncremental(const QString &content, QVector<LaTeXError> &errors,
+                                 const std::function<bool()> &isCancelled = {}, int pauseAfterLine = -1);
+    void clearIncrementalState();
+
+    // Groups of checks that can be switched off and profiled one by one.
+    // Switching off a rule that tracks state, such as open braces, only hides
+    // its errors; the other rules still see the state.
+    enum Rule : quint8 {
+        BraceRule,              // Unmatched and unclosed braces and brackets
+        EnvironmentRule,        // \begin and \end pairs
+        MathDelimiterRule,      // $ on one line, \( \) and \[ \] in the document
+        CommandSpacingRule,     // Command glued to a word, as in "the\LaTeX"
+        PackageOrderRule,       // \usepackage after \begin{document}
+        UnknownCommandRule,
+        ArgumentCountRule,
+        MathModeRule,           // Math-only commands outside math
+        MissingPackageRule,
+        DeprecatedCommandRule,
+        MultipleSpacesRule,
+        BareMathRule,           // Comparisons such as "x = 5" outside math
+        LineBreakRule,          // \\ outside tables
+        RuleCount
+    };
+
+    // Name used in settings and on the command line, such as "bare-math"
+    static QString ruleName(Rule rule);
+    // Returns RuleCount for an unknown name
+    static Rule ruleFromName(const QString &name);
+    static Rule ruleOf(LaTeXError::MessageId messageId);
+
+    // Changing the rules drops the incremental state
+    void setRuleEnabled(Rule rule, bool enabled);
+    bool isRuleEnabled(Rule rule) const { return !(m_disabledRules & (1u << rule)); }
+
+    // Cost of one rule over all checks since the last reset
+    struct RuleStats {
+        quint64 runs = 0;         // Times the rule was evaluated
+        quint64 hits = 0;         // Errors it reported
+        qint64 nanoseconds = 0;
+    };
+
+    // Profiling times every rule evaluation, which slows checking down. While
+    // it is on, each check also records the time per rule in PerformanceMonitor
+    // as "Rules: <name>". The counters are not synchronized: only profile a
+    // checker used by one thread at a time.
+    void setProfilingEnabled(bool enabled) { m_profiling = enabled; }
+    bool isProfilingEnabled() const { return m_profiling; }
+    QVector<RuleStats> ruleStats() const;   // Indexed by Rule
+    void resetRuleStats();
+    // Table of the stats, most expensive rule first, for debug output
+    static QString ruleStatsReport(const QVector<RuleStats> &stats);
 
-private:
     struct BraceInfo {
         int line;
         int column;
         char type; // '{', '[', etc.
+        QString file;
     };
 
     struct EnvironmentInfo {
         QString name;
         int line;
         int column;
+        QString file;
     };
 
-    QVector<LaTeXError> checkBraces(const QString &content);
-    QVector<LaTeXError> checkEnvironments(const QString &content);
-    QVector<LaTeXError> checkMathDelimiters(const QString &content);
-    QVector<LaTeXError> checkCommands(const QString &content);
-    QVector<LaTeXError> checkPackages(const QString &content);
-    QVector<LaTeXError> checkCommonMistakes(const QString &content);
+    // Document state carried from token to token, and from file to file in a project
+    struct ScanState {
+        QString file;   // Project file being scanned, empty for the edited document
+        QStack<BraceInfo> braces;
+        QStack<BraceInfo> brackets;
+        QStack<EnvironmentInfo> environments;
+        QSet<QString> loadedPackages;
+        int beginDocumentLine = -1;
+        int inlineMathBalance = 0;   // \( \)
+        int displayMathBalance = 0;  // \[ \]
+        bool inlineDollarMath = false;   // Inside $ $
+        bool displayDollarMath = false;  // Inside $$ $$
 
-    bool isInComment(const QString &line, int position);
-    void getLineColumn(const QString &content, int position, int &line, int &column);
+        // Commands defined by the document. Inside a definition, or after a
+        // file or package without a word list was loaded, unknown commands
+        // and mode errors are not reported.
+        QSet<QString> definedCommands;
+        int definitionDepth = -1;        // Brace depth of the current definition, -1 outside
+        bool externalDefinitions = false;
 
-    // Command and package databases
-    struct CommandInfo {
-        QString name;
-        int requiredArgs;
-        int optionalArgs;
-        QString requiredPackage;
-        bool mathModeOnly;
-        bool textModeOnly;
-        QString deprecatedReplacement;
+        // Arguments of the last \usepackage
+        enum PackageArgument {
+            NoPackageArgument,
+            ExpectPackageOptions,
+            InPackageOptions,
+            ExpectPackageList,
+            InPackageList
+        };
+        PackageArgument packageArgument = NoPackageArgument;
+        bool documentClassArgument = false;  // The arguments belong to \documentclass
+        int packageListDepth = 0;
+        QString packageList;
+    };
+
+    // Project checking. Checks one file of a project starting from 'state',
+    // the scan state where the file is included, and leaves 'state' at the end
+    // of the file. Each \input, \include and \subfile is passed to 'included',
+    // which may replace the state with the one at the end of that file.
+    using IncludeCallback = std::function<void(const QString &name, ScanState &state)>;
+    void checkFile(const QString &file, QStringView content, ScanState &state,
+                   QVector<LaTeXError> &errors, const IncludeCallback &included) const;
+    // Reports what is still open at the end of the main file
+    void finishProject(ScanState &state, QVector<LaTeXError> &errors) const;
+    static bool sameState(const ScanState &current, const ScanState &previous);
+
+private:
+    // Facts about the current line. Line rules are decided when the line ends.
+    struct LineState {
+        int line = 0;
+        qsizetype start = 0;
+        int dollarCount = 0;
+        bool hasDollar = false;
+        bool hasAlignment = false;
+        bool hasEnvironment = false;
+        bool hasVerb = false;
+        bool sawContent = false;
+        bool commentOnly = false;
+        int lineBreakColumn = -1;
+        int doubleSpaceColumn = -1;
+        int mathExpressionColumn = -1;
+        int mathExpressionLength = 0;
+    };
+
+    // Scan state at the start of a line, kept between incremental runs
+    struct LineCheckpoint {
+        qsizetype start = 0;
+        bool resumable = false;      // false inside raw text such as verbatim bodies
+        ScanState state;             // valid if resumable
     };
 
-    void initializeCommandDatabase();
-    void initializePackageDatabase();
-    QMap<QString, CommandInfo> m_commandDatabase;
-    QMap<QString, QString> m_packageCommands; // command -> package
-    QSet<QString> m_mathCommands;
-    QSet<QString> m_deprecatedCommands;
+    // Called at the start of every line; returning false stops the scan
+    using LineCallback = std::function<bool(int line, qsizetype start, const ScanState &state)>;
+
+    // All rules run on the token stream of a single tokenizer pass. 'from'
+    // must be the start of line 'firstLine'.
+    void scan(QStringView content, qsizetype from, int firstLine, ScanState &state,
+              QVector<LaTeXError> &errors, const LineCallback &lineStarted = {},
+              const IncludeCallback &included = {}) const;
+    void checkCommand(QStringView content, LaTeXTokenizer &tokenizer, const LaTeXToken &token,
+                      ScanState &state, LineState &line, QVector<LaTeXError> &errors,
+                      const IncludeCallback &included) const;
+    void trackPackageArgument(const LaTeXToken &token, ScanState &state) const;
+    void loadPackage(const QString &package, ScanState &state) const;
+    static bool inMathMode(const ScanState &state);
+    void checkText(QStringView content, const LaTeXToken &token, LineState &line) const;
+    void finishLine(QStringView content, const LineState &line, QVector<LaTeXError> &errors) const;
+    void finishDocument(ScanState &state, QVector<LaTeXError> &errors) const;
+
+    static bool sameState(const ScanState &current, const ScanState &previous, int shiftFrom, int delta);
+    static void shiftState(ScanState &state, int shiftFrom, int delta);
+    static QStringView lineText(QStringView content, qsizetype lineStart);
+
+    // Appends 'error' in 'file' unless its rule is switched off
+    void report(QVector<LaTeXError> &errors, const LaTeXError &error, const QString &file = QString()) const;
+    // Counters to update for 'rule', or nullptr when not profiling
+    RuleStats *profile(Rule rule) const { return m_profiling ? &m_ruleStats[rule] : nullptr; }
+
+    // Known commands, shared with every other checker
+    LaTeXCommandTable m_commands;
+    Limits m_limits;
+    quint32 m_disabledRules = 0;   // Bit per Rule
+    bool m_profiling = false;
+    mutable RuleStats m_ruleStats[RuleCount];
+
+    // Incremental state of the last checked document
+    QString m_content;
+    QVector<LineCheckpoint> m_lines;
+    QVector<LaTeXError> m_errors;   // Errors on the lines, sorted by position
+    ScanState m_finalState;         // Valid if m_complete
+    bool m_complete = false;        // m_lines reach the end of m_content
 };
 
 #endif // LATEXERRORCHECKER_H
@@ -4,6 +4,7 @@
 
 LaTeXHighlighter::LaTeXHighlighter(QTextDocument *parent)
         : QSyntaxHighlighter(parent)
+        , m_passTimer("Highlighting: syntax pass")
 {
     setupHighlightingRules();
 }
@@ -72,6 +73,7 @@ void LaTeXHighlighter::updateTheme(const Theme &theme)
 
 void LaTeXHighlighter::highlightBlock(const QString &text)
 {
+    ScopedTimer timer(m_passTimer);
     for (const HighlightingRule &rule : std::as_const(highlightingRules)) {
         QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
         while (matchIterator.hasNext()) {
@@ -5,6 +5,7 @@
 #include <QTextCharFormat>
 #include <QRegularExpression>
 #include "../models/Theme.h"
+#include "PerformanceMonitor.h"
 
 class LaTeXHighlighter : public QSyntaxHighlighter
 {
@@ -24,6 +25,7 @@ private:
         QTextCharFormat format;
     };
     QVector<HighlightingRule> highlightingRules;
+    PassTimer m_passTimer;
 
     void setupHighlightingRules();
 };
@@ -0,0 +1,465 @@
+// LaTeXHtmlEmitter.cpp
+#include "LaTeXHtmlEmitter.h"
+#include <QByteArray>
+#include <algorithm>
+
+void LaTeXConversionTables::prepareSymbols() {
+    orderedSymbols.clear();
+
+    // Text is scanned for the first character of every symbol and for the
+    // characters HTML needs escaped
+    QByteArray scannerCharacters("<>&");
+
+    // Symbols are matched longest first so that --- wins over --
+    for (auto it = symbols.constBegin(); it != symbols.constEnd(); ++it) {
+        if (it.key().isEmpty()) {
+            continue;
+        }
+        orderedSymbols.append(LaTeXSymbolRule{it.key(), it.value()});
+        const char16_t first = it.key().at(0).unicode();
+        if (first < 128) {
+            scannerCharacters += static_cast<char>(first);
+        }
+    }
+    textScanner = LaTeXCharScanner(QLatin1String(scannerCharacters.constData(), scannerCharacters.size()));
+
+    std::stable_sort(orderedSymbols.begin(), orderedSymbols.end(),
+                     [](const LaTeXSymbolRule &a, const LaTeXSymbolRule &b) {
+        return a.key.size() > b.key.size();
+    });
+}
+
+LaTeXHtmlEmitter::LaTeXHtmlEmitter(const LaTeXConversionTables &tables)
+    : m_tables(tables)
+    , m_root(nullptr)
+{
+}
+
+QString LaTeXHtmlEmitter::convert(QStringView latex) {
+    QString html;
+    html.reserve(latex.size() + latex.size() / 4);
+    convert(latex, html);
+    return html;
+}
+
+bool LaTeXHtmlEmitter::convert(QStringView latex, QString &html) {
+    m_root = &html;
+    m_groupStack.clear();
+    m_tableStack.clear();
+
+    LaTeXTokenizer tokenizer(latex);
+    emitTokens(tokenizer);
+    const bool selfContained = m_groupStack.isEmpty() && m_tableStack.isEmpty() && !tokenizer.reachedEnd();
+
+    // Close whatever the source left open
+    while (!m_tableStack.isEmpty()) {
+        endTable();
+    }
+    while (!m_groupStack.isEmpty()) {
+        closeGroup();
+    }
+    m_root = nullptr;
+    return selfContained;
+}
+
+void LaTeXHtmlEmitter::emitFragment(QStringView latex) {
+    const qsizetype depth = m_groupStack.size();
+    LaTeXTokenizer tokenizer(latex);
+    emitTokens(tokenizer);
+    while (m_groupStack.size() > depth) {
+        closeGroup();
+    }
+}
+
+void LaTeXHtmlEmitter::emitTokens(LaTeXTokenizer &tokenizer) {
+    while (true) {
+        const LaTeXToken token = tokenizer.next();
+        switch (token.type) {
+            case LaTeXToken::End:
+                return;
+            case LaTeXToken::Text:
+                emitText(token.text);
+                break;
+            case LaTeXToken::Command:
+                emitCommand(tokenizer, token.text);
+                break;
+            case LaTeXToken::BeginGroup:
+                openGroup(QStringLiteral("{"), QStringLiteral("}"));
+                break;
+            case LaTeXToken::EndGroup:
+                closeGroup();
+                break;
+            case LaTeXToken::BeginOptional:
+            case LaTeXToken::EndOptional:
+            case LaTeXToken::Newline:
+                out() += token.text;
+                break;
+            case LaTeXToken::MathShift:
+                emitMath(tokenizer, u"$", u"$");
+                break;
+            case LaTeXToken::DisplayMathShift:
+                emitMath(tokenizer, u"$$", u"$$");
+                break;
+            case LaTeXToken::Alignment:
+                if (m_tableStack.isEmpty()) {
+                    out() += QLatin1String("&amp;");
+                } else {
+                    endCell();
+                }
+                break;
+            case LaTeXToken::Comment:
+                break;
+        }
+    }
+}
+
+void LaTeXHtmlEmitter::emitCommand(LaTeXTokenizer &tokenizer, QStringView name) {
+    const auto it = m_tables.commands.constFind(QString::fromRawData(name.data(), name.size()));
+    if (it == m_tables.commands.constEnd()) {
+        emitRawCommand(name);
+        return;
+    }
+
+    const LaTeXCommandRule &rule = it.value();
+    switch (rule.kind) {
+        case LaTeXCommandRule::Replace:
+            out() += rule.open;
+            break;
+        case LaTeXCommandRule::Wrap:
+            if (tokenizer.beginGroup(true)) {
+                openGroup(rule.open, rule.close);
+            } else {
+                emitRawCommand(name);
+            }
+            break;
+        case LaTeXCommandRule::Template: {
+            const LaTeXTokenizer::Mark start = tokenizer.mark();
+            QStringView argument;
+            tokenizer.readOptional(argument);
+            if (tokenizer.readGroup(argument)) {
+                if (!rule.open.isEmpty()) {
+                    out() += fillTemplate(rule.open, argument);
+                }
+            } else {
+                tokenizer.reset(start);
+                emitRawCommand(name);
+            }
+            break;
+        }
+        case LaTeXCommandRule::TemplateWrap: {
+            const LaTeXTokenizer::Mark start = tokenizer.mark();
+            QStringView argument;
+            if (tokenizer.readGroup(argument)
+                && (rule.allowedArguments.isEmpty() || rule.allowedArguments.contains(argument))
+                && tokenizer.beginGroup()) {
+                openGroup(fillTemplate(rule.open, argument), rule.close);
+            } else {
+                tokenizer.reset(start);
+                emitRawCommand(name);
+            }
+            break;
+        }
+        case LaTeXCommandRule::Handler:
+            emitHandler(tokenizer, rule.handler, name);
+            break;
+    }
+}
+
+void LaTeXHtmlEmitter::emitHandler(LaTeXTokenizer &tokenizer, LaTeXCommandRule::HandlerId handler,
+                                   QStringView name) {
+    switch (handler) {
+        case LaTeXCommandRule::Begin:
+            emitBeginEnvironment(tokenizer);
+            break;
+        case LaTeXCommandRule::End:
+            emitEndEnvironment(tokenizer);
+            break;
+        case LaTeXCommandRule::Item: {
+            QStringView label;
+            if (tokenizer.readOptional(label)) {
+                out() += QLatin1String("<dt>");
+                emitFragment(label);
+                out() += QLatin1String("</dt><dd>");
+            } else {
+                out() += QLatin1String("<li>");
+            }
+            tokenizer.skipWhitespace();
+            break;
+        }
+        case LaTeXCommandRule::Verb: {
+            QStringView code;
+            if (tokenizer.readDelimited(code)) {
+                QString &html = out();
+                html += QLatin1String("<code>");
+                appendEscaped(html, code);
+                html += QLatin1String("</code>");
+            } else {
+                emitRawCommand(name);
+            }
+            break;
+        }
+        case LaTeXCommandRule::InlineMath:
+            emitMath(tokenizer, u"\\(", u"\\)");
+            break;
+        case LaTeXCommandRule::DisplayMath:
+            emitMath(tokenizer, u"\\[", u"\\]");
+            break;
+        case LaTeXCommandRule::LineBreak:
+            if (m_tableStack.isEmpty()) {
+                out() += QLatin1String("<br>");
+            } else {
+                endRow();
+            }
+            break;
+        case LaTeXCommandRule::NoHandler:
+            emitRawCommand(name);
+            break;
+    }
+}
+
+void LaTeXHtmlEmitter::emitBeginEnvironment(LaTeXTokenizer &tokenizer) {
+    QStringView name;
+    if (!tokenizer.readGroup(name)) {
+        emitRawCommand(u"begin");
+        return;
+    }
+
+    const auto it = m_tables.environments.constFind(QString::fromRawData(name.data(), name.size()));
+    if (it == m_tables.environments.constEnd()) {
+        QString &html = out();
+        html += QLatin1String("\\begin{");
+        appendEscaped(html, name);
+        html += QLatin1Char('}');
+        return;
+    }
+
+    const LaTeXEnvironmentRule &rule = it.value();
+    QString endMarker = QLatin1String("\\end{");
+    endMarker += name;
+    endMarker += QLatin1Char('}');
+    QStringView body;
+
+    switch (rule.kind) {
+        case LaTeXEnvironmentRule::Wrap:
+            if (rule.skipOptional) {
+                tokenizer.readOptional(body);
+            }
+            out() += rule.open;
+            break;
+        case LaTeXEnvironmentRule::Ignore:
+            break;
+        case LaTeXEnvironmentRule::Verbatim: {
+            tokenizer.readUntil(endMarker, body);
+            QString &html = out();
+            html += rule.open;
+            appendEscaped(html, body);
+            html += rule.close;
+            break;
+        }
+        case LaTeXEnvironmentRule::Math: {
+            tokenizer.readUntil(endMarker, body);
+            QString &html = out();
+            html += QLatin1String("\\begin{");
+            html += name;
+            html += QLatin1Char('}');
+            appendEscaped(html, body);
+            html += endMarker;
+            break;
+        }
+        case LaTeXEnvironmentRule::Equation: {
+            tokenizer.readUntil(endMarker, body);
+            QString &html = out();
+            html += QLatin1String("\\[");
+            appendEscaped(html, body);
+            html += QLatin1String("\\]");
+            break;
+        }
+        case LaTeXEnvironmentRule::Tabular:
+            tokenizer.readGroup(body); // Column specification
+            beginTable();
+            break;
+    }
+}
+
+void LaTeXHtmlEmitter::emitEndEnvironment(LaTeXTokenizer &tokenizer) {
+    QStringView name;
+    if (!tokenizer.readGroup(name)) {
+        emitRawCommand(u"end");
+        return;
+    }
+
+    const auto it = m_tables.environments.constFind(QString::fromRawData(name.data(), name.size()));
+    if (it == m_tables.environments.constEnd()) {
+        QString &html = out();
+        html += QLatin1String("\\end{");
+        appendEscaped(html, name);
+        html += QLatin1Char('}');
+        return;
+    }
+
+    const LaTeXEnvironmentRule &rule = it.value();
+    switch (rule.kind) {
+        case LaTeXEnvironmentRule::Wrap:
+            out() += rule.close;
+            break;
+        case LaTeXEnvironmentRule::Tabular:
+            if (!m_tableStack.isEmpty()) {
+                endTable();
+            }
+            break;
+        case LaTeXEnvironmentRule::Ignore:
+        case LaTeXEnvironmentRule::Verbatim:
+        case LaTeXEnvironmentRule::Math:
+        case LaTeXEnvironmentRule::Equation:
+            break;
+    }
+}
+
+void LaTeXHtmlEmitter::emitMath(LaTeXTokenizer &tokenizer, QStringView open, QStringView close) {
+    // Math is left for MathJax, only escaped so the browser keeps it as text
+    QStringView body;
+    const bool closed = tokenizer.readUntil(close, body);
+    QString &html = out();
+    html += open;
+    appendEscaped(html, body);
+    if (closed) {
+        html += close;
+    }
+}
+
+void LaTeXHtmlEmitter::emitText(QStringView text) {
+    QString &html = out();
+    const char16_t *data = text.utf16();
+    const qsizetype size = text.size();
+    qsizetype runStart = 0;
+    qsizetype i = 0;
+
+    // One pass: the scanner skips ordinary text, then each hit is either
+    // escaped or matched against the symbols
+    while ((i = m_tables.textScanner.indexIn(data, i, size)) < size) {
+        QLatin1String entity;
+        switch (data[i]) {
+            case '&': entity = QLatin1String("&amp;"); break;
+            case '<': entity = QLatin1String("&lt;"); break;
+            case '>': entity = QLatin1String("&gt;"); break;
+            default: break;
+        }
+        if (entity.size() > 0) {
+            html += text.mid(runStart, i - runStart);
+            html += entity;
+            runStart = ++i;
+            continue;
+        }
+
+        const QStringView rest = text.mid(i);
+        const LaTeXSymbolRule *match = nullptr;
+        for (const LaTeXSymbolRule &symbol : m_tables.orderedSymbols) {
+            if (rest.startsWith(symbol.key)) {
+                match = &symbol;
+                break;
+            }
+        }
+        if (!match) {
+            ++i;
+            continue;
+        }
+
+        html += text.mid(runStart, i - runStart);
+        html += match->html;
+        i += match->key.size();
+        runStart = i;
+    }
+
+    html += text.mid(runStart);
+}
+
+void LaTeXHtmlEmitter::emitRawCommand(QStringView name) {
+    QString &html = out();
+    html += QLatin1Char('\\');
+    appendEscaped(html, name);
+}
+
+void LaTeXHtmlEmitter::openGroup(const QString &open, const QString &close) {
+    out() += open;
+    m_groupStack.append(close);
+}
+
+void LaTeXHtmlEmitter::closeGroup() {
+    if (m_groupStack.isEmpty()) {
+        out() += QLatin1Char('}');
+        return;
+    }
+    out() += m_groupStack.takeLast();
+}
+
+void LaTeXHtmlEmitter::beginTable() {
+    m_tableStack.append(TableFrame());
+}
+
+void LaTeXHtmlEmitter::endCell() {
+    TableFrame &table = m_tableStack.last();
+    table.cells.append(table.cell.trimmed());
+    table.cell.resize(0);
+}
+
+void LaTeXHtmlEmitter::endRow() {
+    endCell();
+
+    TableFrame &table = m_tableStack.last();
+    const bool emptyRow = table.cells.size() == 1 && table.cells.first().isEmpty();
+    if (!emptyRow) {
+        table.rows += QLatin1String("<tr>");
+        for (const QString &cell : std::as_const(table.cells)) {
+            table.rows += QLatin1String("<td>");
+            table.rows += cell;
+            table.rows += QLatin1String("</td>");
+        }
+        table.rows += QLatin1String("</tr>");
+    }
+    table.cells.clear();
+}
+
+void LaTeXHtmlEmitter::endTable() {
+    endRow();
+
+    const TableFrame table = m_tableStack.takeLast();
+    QString &html = out();
+    html += QLatin1String("<table border='1' cellpadding='5' cellspacing='0'>");
+    html += table.rows;
+    html += QLatin1String("</table>");
+}
+
+// Also escapes quotes, so the result is safe inside quoted attribute values
+void LaTeXHtmlEmitter::appendEscaped(QString &html, QStringView text) {
+    static const LaTeXCharScanner escapeScanner(QLatin1String("&<>'\""));
+
+    const char16_t *data = text.utf16();
+    const qsizetype size = text.size();
+    qsizetype runStart = 0;
+    qsizetype i = 0;
+
+    while ((i = escapeScanner.indexIn(data, i, size)) < size) {
+        QLatin1String entity;
+        switch (data[i]) {
+            case '&': entity = QLatin1String("&amp;"); break;
+            case '<': entity = QLatin1String("&lt;"); break;
+            case '>': entity = QLatin1String("&gt;"); break;
+            case '\'': entity = QLatin1String("&#39;"); break;
+            default: entity = QLatin1String("&quot;"); break;
+        }
+        html += text.mid(runStart, i - runStart);
+        html += entity;
+        runStart = ++i;
+    }
+
+    html += text.mid(runStart);
+}
+
+// The argument is escaped before it is substituted, since templates place it
+// in text as well as in attribute values
+QString LaTeXHtmlEmitter::fillTemplate(const QString &html, QStringView argument) {
+    QString escaped;
+    escaped.reserve(argument.size());
+    appendEscaped(escaped, argument);
+    return html.arg(escaped);
+}
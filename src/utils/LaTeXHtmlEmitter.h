@@ -0,0 +1,127 @@
+// LaTeXHtmlEmitter.h
+#ifndef LATEXHTMLEMITTER_H
+#define LATEXHTMLEMITTER_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include "LaTeXTokenizer.h"
+#include "LaTeXCharScanner.h"
+
+// How a command is turned into HTML
+struct LaTeXCommandRule {
+    enum Kind {
+        Replace,        // Emit 'open' in place of the command
+        Wrap,           // One argument: emit 'open', the converted argument, then 'close'
+        Template,       // One raw argument substituted for %1 in 'open'
+        TemplateWrap,   // A raw argument substituted into 'open', then a converted argument and 'close'
+        Handler         // Dispatched to a dedicated emitter method
+    };
+
+    enum HandlerId {
+        NoHandler,
+        Begin,
+        End,
+        Item,
+        Verb,
+        InlineMath,
+        DisplayMath,
+        LineBreak
+    };
+
+    Kind kind = Replace;
+    QString open;
+    QString close;
+    HandlerId handler = NoHandler;
+    QStringList allowedArguments;   // Template arguments that are substituted, any if empty
+};
+
+// How an environment is turned into HTML
+struct LaTeXEnvironmentRule {
+    enum Kind {
+        Wrap,       // Emit 'open', the converted body, then 'close'
+        Ignore,     // Drop the \begin and \end markers, convert the body
+        Verbatim,   // Emit 'open', the escaped raw body, then 'close'
+        Math,       // Pass the whole environment through for MathJax
+        Equation,   // Pass the body through as display math
+        Tabular     // Convert rows and cells into an HTML table
+    };
+
+    Kind kind = Wrap;
+    QString open;
+    QString close;
+    bool skipOptional = false;
+};
+
+struct LaTeXSymbolRule {
+    QString key;
+    QString html;
+};
+
+// Filled once and then only read, so one instance can be shared by emitters
+// running on different threads
+struct LaTeXConversionTables {
+    QMap<QString, QString> symbols;                       // Text ligatures such as -- and ``
+    QHash<QString, LaTeXCommandRule> commands;            // Command name -> rule
+    QHash<QString, LaTeXEnvironmentRule> environments;    // Environment name -> rule
+
+    // Derived from 'symbols' by prepareSymbols()
+    QVector<LaTeXSymbolRule> orderedSymbols;              // Longest key first
+    LaTeXCharScanner textScanner;                         // Symbol starts and characters to escape
+
+    void prepareSymbols();
+};
+
+// Walks the token stream once and writes HTML as it goes. Each command is
+// looked up in the conversion tables and dispatched to its rule.
+class LaTeXHtmlEmitter {
+public:
+    explicit LaTeXHtmlEmitter(const LaTeXConversionTables &tables);
+
+    QString convert(QStringView latex);
+    // Returns false if the result depends on text after 'latex': a group or
+    // table is left open, or an argument, math or whitespace runs up to the
+    // end. Converting 'latex' as part of a longer source may then give other
+    // HTML, so a block for which this fails must be converted together with
+    // the blocks after it.
+    bool convert(QStringView latex, QString &html);
+
+private:
+    struct TableFrame {
+        QString rows;
+        QString cell;
+        QStringList cells;
+    };
+
+    void emitTokens(LaTeXTokenizer &tokenizer);
+    void emitFragment(QStringView latex);
+    void emitCommand(LaTeXTokenizer &tokenizer, QStringView name);
+    void emitHandler(LaTeXTokenizer &tokenizer, LaTeXCommandRule::HandlerId handler, QStringView name);
+    void emitBeginEnvironment(LaTeXTokenizer &tokenizer);
+    void emitEndEnvironment(LaTeXTokenizer &tokenizer);
+    void emitMath(LaTeXTokenizer &tokenizer, QStringView open, QStringView close);
+    void emitText(QStringView text);
+    void emitRawCommand(QStringView name);
+
+    void openGroup(const QString &open, const QString &close);
+    void closeGroup();
+
+    void beginTable();
+    void endCell();
+    void endRow();
+    void endTable();
+
+    QString &out() { return m_tableStack.isEmpty() ? *m_root : m_tableStack.last().cell; }
+    static void appendEscaped(QString &html, QStringView text);
+    static QString fillTemplate(const QString &html, QStringView argument);
+
+    const LaTeXConversionTables &m_tables;
+    QString *m_root;
+    QVector<QString> m_groupStack;
+    QVector<TableFrame> m_tableStack;
+};
+
+#endif // LATEXHTMLEMITTER_H
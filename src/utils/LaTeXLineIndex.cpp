@@ -0,0 +1,53 @@
+// LaTeXLineIndex.cpp
+#include "LaTeXLineIndex.h"
+#include "LaTeXCharScanner.h"
+
+LaTeXLineIndex::LaTeXLineIndex(QStringView text)
+    : m_text(text)
+{
+    static const LaTeXCharScanner lineScanner(QLatin1String("\n%"));
+    static const LaTeXCharScanner newlineScanner(QLatin1String("\n"));
+
+    const char16_t *data = text.utf16();
+    const qsizetype size = text.size();
+
+    // Guess from a typical line length to avoid most reallocations
+    m_lineStarts.reserve(size / 32 + 1);
+    m_commentColumns.reserve(size / 32 + 1);
+    m_lineStarts.append(0);
+    m_commentColumns.append(-1);
+
+    qsizetype pos = 0;
+    while ((pos = lineScanner.indexIn(data, pos, size)) < size) {
+        if (data[pos] == '\n') {
+            m_lineStarts.append(pos + 1);
+            m_commentColumns.append(-1);
+            ++pos;
+            continue;
+        }
+
+        // An odd number of backslashes in front escapes the %
+        const qsizetype lineStart = m_lineStarts.last();
+        qsizetype backslashes = 0;
+        while (pos - backslashes - 1 >= lineStart && data[pos - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 != 0) {
+            ++pos;
+            continue;
+        }
+
+        // The rest of the line is comment; only its end matters
+        m_commentColumns.last() = static_cast<int>(pos - lineStart);
+        pos = newlineScanner.indexIn(data, pos + 1, size);
+    }
+}
+
+qsizetype LaTeXLineIndex::lineEnd(int line) const {
+    return line + 1 < m_lineStarts.size() ? m_lineStarts[line + 1] - 1 : m_text.size();
+}
+
+QStringView LaTeXLineIndex::line(int line) const {
+    const qsizetype start = m_lineStarts[line];
+    return m_text.mid(start, lineEnd(line) - start);
+}
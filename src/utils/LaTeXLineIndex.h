@@ -0,0 +1,32 @@
+// LaTeXLineIndex.h
+#ifndef LATEXLINEINDEX_H
+#define LATEXLINEINDEX_H
+
+#include <QStringView>
+#include <QVector>
+
+// Line starts and comment starts of a text, found in one vectorized scan for
+// newlines and percent signs. Afterwards line and comment queries take O(1).
+// The index refers to the text it was built from, which must outlive it.
+class LaTeXLineIndex {
+public:
+    LaTeXLineIndex() = default;
+    explicit LaTeXLineIndex(QStringView text);
+
+    int lineCount() const { return static_cast<int>(m_lineStarts.size()); }
+    qsizetype lineStart(int line) const { return m_lineStarts[line]; }
+    // Position of the newline that ends the line, or the end of the text
+    qsizetype lineEnd(int line) const;
+    // The line without its newline
+    QStringView line(int line) const;
+
+    // Column of the first unescaped % of the line, or -1 if it has no comment
+    int commentColumn(int line) const { return m_commentColumns[line]; }
+
+private:
+    QStringView m_text;
+    QVector<qsizetype> m_lineStarts;
+    QVector<int> m_commentColumns;
+};
+
+#endif // LATEXLINEINDEX_H
@@ -0,0 +1,414 @@
+// LaTeXProjectLinter.cpp
+#include "LaTeXProjectLinter.h"
+#include "LaTeXCommandDatabase.h"
+#include "PerformanceMonitor.h"
+#include "../models/ProjectModel.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Bump when the checker reports different errors for the same input
+const quint32 CacheVersion = 2;
+const char CacheMagic[] = "LTXLINT";
+
+using ScanState = LaTeXErrorChecker::ScanState;
+
+void writeBraces(QDataStream &out, const QStack<LaTeXErrorChecker::BraceInfo> &stack) {
+    out << qint32(stack.size());
+    for (const LaTeXErrorChecker::BraceInfo &info : stack) {
+        out << qint32(info.line) << qint32(info.column) << qint8(info.type) << info.file;
+    }
+}
+
+void readBraces(QDataStream &in, QStack<LaTeXErrorChecker::BraceInfo> &stack) {
+    qint32 count = 0;
+    in >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 line = 0;
+        qint32 column = 0;
+        qint8 type = 0;
+        QString file;
+        in >> line >> column >> type >> file;
+        stack.push({line, column, static_cast<char>(type), file});
+    }
+}
+
+void writeState(QDataStream &out, const ScanState &state) {
+    out << state.file;
+    writeBraces(out, state.braces);
+    writeBraces(out, state.brackets);
+    out << qint32(state.environments.size());
+    for (const LaTeXErrorChecker::EnvironmentInfo &info : state.environments) {
+        out << info.name << qint32(info.line) << qint32(info.column) << info.file;
+    }
+    out << state.loadedPackages << qint32(state.beginDocumentLine)
+        << qint32(state.inlineMathBalance) << qint32(state.displayMathBalance)
+        << state.inlineDollarMath << state.displayDollarMath
+        << state.definedCommands << qint32(state.definitionDepth) << state.externalDefinitions
+        << qint32(state.packageArgument) << state.documentClassArgument
+        << qint32(state.packageListDepth) << state.packageList;
+}
+
+void readState(QDataStream &in, ScanState &state) {
+    in >> state.file;
+    readBraces(in, state.braces);
+    readBraces(in, state.brackets);
+    qint32 count = 0;
+    in >> count;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        LaTeXErrorChecker::EnvironmentInfo info;
+        qint32 line = 0;
+        qint32 column = 0;
+        in >> info.name >> line >> column >> info.file;
+        info.line = line;
+        info.column = column;
+        state.environments.push(info);
+    }
+
+    qint32 beginDocumentLine = -1;
+    qint32 inlineMathBalance = 0;
+    qint32 displayMathBalance = 0;
+    qint32 definitionDepth = -1;
+    qint32 packageArgument = 0;
+    qint32 packageListDepth = 0;
+    in >> state.loadedPackages >> beginDocumentLine >> inlineMathBalance >> displayMathBalance
+       >> state.inlineDollarMath >> state.displayDollarMath
+       >> state.definedCommands >> definitionDepth >> state.externalDefinitions
+       >> packageArgument >> state.documentClassArgument >> packageListDepth >> state.packageList;
+    state.beginDocumentLine = beginDocumentLine;
+    state.inlineMathBalance = inlineMathBalance;
+    state.displayMathBalance = displayMathBalance;
+    state.definitionDepth = definitionDepth;
+    state.packageArgument = static_cast<ScanState::PackageArgument>(
+        qBound<qint32>(ScanState::NoPackageArgument, packageArgument, ScanState::InPackageList));
+    state.packageListDepth = packageListDepth;
+}
+
+void writeError(QDataStream &out, const LaTeXError &error) {
+    out << quint8(error.type) << quint8(error.messageId) << qint32(error.line) << qint32(error.column)
+        << qint32(error.length) << qint32(error.number) << error.argument << error.argument2 << error.file;
+}
+
+LaTeXError readError(QDataStream &in) {
+    quint8 type = 0;
+    quint8 messageId = 0;
+    qint32 line = 0;
+    qint32 column = 0;
+    qint32 length = 0;
+    qint32 number = 0;
+    QString argument;
+    QString argument2;
+    QString file;
+    in >> type >> messageId >> line >> column >> length >> number >> argument >> argument2 >> file;
+    LaTeXError error(static_cast<LaTeXError::ErrorType>(qMin<quint8>(type, LaTeXError::TextModeRequired)),
+                     static_cast<LaTeXError::MessageId>(
+                         qMin<quint8>(messageId, quint8(LaTeXError::MessageId::LineBreakOutsideTable))),
+                     line, column, length, argument, argument2, number);
+    error.file = file;
+    return error;
+}
+
+} // namespace
+
+LaTeXProjectLinter::LaTeXProjectLinter()
+{
+}
+
+LaTeXProjectLinter::IncludeMap LaTeXProjectLinter::includeMap(const ProjectModel &project) {
+    IncludeMap map;
+    for (const ProjectFile &file : project.getProjectFiles()) {
+        QHash<QString, QString> &resolved = map[file.filePath];
+        for (const QString &name : file.includedFiles) {
+            const QString path = project.resolveIncludePath(file.filePath, name);
+            if (!path.isEmpty()) {
+                resolved.insert(name, path);
+            }
+        }
+    }
+    return map;
+}
+
+LaTeXProjectLinter::Result LaTeXProjectLinter::lint(const QString &mainFile, const IncludeMap &includes,
+                                                    QThreadPool *pool) {
+    ScopedTimer timer("Lint: project");
+
+    if (!m_checker) {
+        m_checker = std::make_unique<LaTeXErrorChecker>();
+    }
+
+    const QString path = cachePath(mainFile);
+    if (path != m_cachePath) {
+        loadCache(path);
+    }
+
+    Run run;
+    run.includes = &includes;
+
+    // Check one level of the include tree at a time, each file from the state
+    // its parent had at the include. Unchanged files come from the cache.
+    QVector<Pending> level;
+    level.append(Pending{mainFile, ScanState(), m_results.value(mainFile)});
+    QSet<QString> seen;
+    seen.insert(mainFile);
+    while (!level.isEmpty()) {
+        const QVector<FileResult> results = QtConcurrent::blockingMapped<QVector<FileResult>>(
+            pool, level, [this, &includes](const Pending &pending) {
+                return checkFile(pending.file, pending.entry, pending.cached, includes, {});
+            });
+
+        QVector<Pending> next;
+        for (qsizetype i = 0; i < level.size(); ++i) {
+            const FileResult &result = results[i];
+            if (result.checked) {
+                run.checked.insert(level[i].file);
+            }
+            m_results.insert(level[i].file, result);
+            run.current.insert(level[i].file);
+            for (const Include &include : result.includes) {
+                if (!seen.contains(include.file)) {
+                    seen.insert(include.file);
+                    next.append(Pending{include.file, include.before, m_results.value(include.file)});
+                }
+            }
+        }
+        level = next;
+    }
+
+    // Follow the includes in document order; only files that ended in another
+    // state than assumed, and the files after them, are checked again
+    ScanState exit = follow(mainFile, ScanState(), run);
+
+    Result result;
+    result.files = run.order;
+    result.checkedFiles = static_cast<int>(run.checked.size());
+    QHash<QString, int> fileIndex;
+    for (const QString &file : std::as_const(run.order)) {
+        fileIndex.insert(file, static_cast<int>(fileIndex.size()));
+        result.errors.append(m_results.value(file).errors);
+    }
+    m_checker->finishProject(exit, result.errors);
+    std::stable_sort(result.errors.begin(), result.errors.end(),
+        [&fileIndex](const LaTeXError &a, const LaTeXError &b) {
+            return fileIndex.value(a.file) < fileIndex.value(b.file);
+        });
+
+    saveCache();
+    qDebug() << "Linted" << result.files.size() << "files," << result.checkedFiles << "checked,"
+             << result.errors.size() << "errors";
+    return result;
+}
+
+void LaTeXProjectLinter::clearCache() {
+    m_results.clear();
+    if (!m_cachePath.isEmpty()) {
+        QFile::remove(m_cachePath);
+    }
+}
+
+LaTeXProjectLinter::FileResult LaTeXProjectLinter::checkFile(
+        const QString &path, const ScanState &entry, const FileResult &cached,
+        const IncludeMap &includes, const LaTeXErrorChecker::IncludeCallback &included) const {
+    FileResult result;
+    const QFileInfo info(path);
+    result.size = info.size();
+    result.modified = info.lastModified().toMSecsSinceEpoch();
+
+    // A file is only read when its modification time changed
+    const bool sameEntry = cached.size >= 0 && LaTeXErrorChecker::sameState(entry, cached.entry);
+    if (sameEntry && cached.size == result.size && cached.modified == result.modified) {
+        FileResult unchanged = cached;
+        unchanged.checked = false;
+        return unchanged;
+    }
+
+    result.entry = entry;
+    result.exit = entry;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Cannot read" << path << file.errorString();
+        result.checked = true;
+        return result;
+    }
+    const QByteArray data = file.readAll();
+    result.contentHash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    if (sameEntry && cached.contentHash == result.contentHash) {
+        FileResult touched = cached;
+        touched.size = result.size;
+        touched.modified = result.modified;
+        touched.checked = false;
+        return touched;
+    }
+
+    result.checked = true;
+    const QString content = QString::fromUtf8(data);
+    m_checker->checkFile(path, content, result.exit, result.errors,
+        [&](const QString &name, ScanState &state) {
+            const QString includedPath = resolve(includes, path, name);
+            if (includedPath.isEmpty()) {
+                // Not part of the project; it may define anything
+                state.externalDefinitions = true;
+                return;
+            }
+            Include include{includedPath, state, ScanState()};
+            if (included) {
+                included(includedPath, state);
+            }
+            include.after = state;
+            result.includes.append(include);
+        });
+    return result;
+}
+
+LaTeXProjectLinter::ScanState LaTeXProjectLinter::follow(const QString &path, const ScanState &entry, Run &run) {
+    if (run.active.contains(path)) {
+        return entry;
+    }
+    run.active.insert(path);
+    if (!run.order.contains(path)) {
+        run.order.append(path);
+    }
+
+    const FileResult cached = m_results.value(path);
+    bool valid = run.current.contains(path) && cached.size >= 0
+        && LaTeXErrorChecker::sameState(entry, cached.entry);
+    for (qsizetype i = 0; valid && i < cached.includes.size(); ++i) {
+        const Include &include = cached.includes[i];
+        valid = LaTeXErrorChecker::sameState(follow(include.file, include.before, run), include.after);
+    }
+
+    ScanState exit = cached.exit;
+    if (!valid) {
+        // Check again with the real state after every include
+        FileResult result = checkFile(path, entry, FileResult(), *run.includes,
+            [this, &run](const QString &file, ScanState &state) {
+                state = follow(file, state, run);
+            });
+        run.checked.insert(path);
+        run.current.insert(path);
+        exit = result.exit;
+        m_results.insert(path, result);
+    }
+
+    run.active.remove(path);
+    return exit;
+}
+
+QString LaTeXProjectLinter::resolve(const IncludeMap &includes, const QString &file, const QString &name) {
+    // Named like ProjectModel does, with the extension LaTeX adds
+    QString fileName = name;
+    if (!fileName.endsWith(QLatin1String(".tex"))) {
+        fileName += QLatin1String(".tex");
+    }
+    return includes.value(file).value(fileName);
+}
+
+void LaTeXProjectLinter::loadCache(const QString &path) {
+    m_results.clear();
+    m_cachePath = path;
+
+    QFile file(path);
+    if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    QByteArray magic;
+    quint32 version = 0;
+    quint64 commands = 0;
+    qint32 count = 0;
+    in >> magic >> version >> commands >> count;
+    if (in.status() != QDataStream::Ok || magic != CacheMagic || version != CacheVersion
+        || commands != LaTeXCommandDatabase::commands().sourceFingerprint()) {
+        return;
+    }
+
+    QHash<QString, FileResult> results;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        FileResult result;
+        in >> name >> result.size >> result.modified >> result.contentHash;
+        readState(in, result.entry);
+        readState(in, result.exit);
+
+        qint32 includeCount = 0;
+        in >> includeCount;
+        for (qint32 j = 0; j < includeCount && in.status() == QDataStream::Ok; ++j) {
+            Include include;
+            in >> include.file;
+            readState(in, include.before);
+            readState(in, include.after);
+            result.includes.append(include);
+        }
+
+        qint32 errorCount = 0;
+        in >> errorCount;
+        for (qint32 j = 0; j < errorCount && in.status() == QDataStream::Ok; ++j) {
+            result.errors.append(readError(in));
+        }
+        results.insert(name, result);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring damaged lint cache" << path;
+        return;
+    }
+    m_results = results;
+}
+
+void LaTeXProjectLinter::saveCache() const {
+    if (m_cachePath.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(m_cachePath).absolutePath());
+    QSaveFile file(m_cachePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write lint cache" << m_cachePath << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << QByteArray(CacheMagic) << CacheVersion << LaTeXCommandDatabase::commands().sourceFingerprint()
+        << qint32(m_results.size());
+    for (auto it = m_results.constBegin(); it != m_results.constEnd(); ++it) {
+        const FileResult &result = it.value();
+        out << it.key() << result.size << result.modified << result.contentHash;
+        writeState(out, result.entry);
+        writeState(out, result.exit);
+        out << qint32(result.includes.size());
+        for (const Include &include : result.includes) {
+            out << include.file;
+            writeState(out, include.before);
+            writeState(out, include.after);
+        }
+        out << qint32(result.errors.size());
+        for (const LaTeXError &error : result.errors) {
+            writeError(out, error);
+        }
+    }
+
+    if (!file.commit()) {
+        qWarning() << "Cannot write lint cache" << m_cachePath << file.errorString();
+    }
+}
+
+QString LaTeXProjectLinter::cachePath(const QString &mainFile) {
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (cacheDir.isEmpty()) {
+        return QString();
+    }
+    // One cache per main file
+    const QByteArray key = QCryptographicHash::hash(mainFile.toUtf8(), QCryptographicHash::Md5).toHex();
+    return QDir(cacheDir).filePath(QString("lint/%1.cache").arg(QString::fromLatin1(key)));
+}
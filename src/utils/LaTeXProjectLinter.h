@@ -0,0 +1,108 @@
+// LaTeXProjectLinter.h
+#ifndef LATEXPROJECTLINTER_H
+#define LATEXPROJECTLINTER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+#include "LaTeXErrorChecker.h"
+
+class ProjectModel;
+
+// Checks every file of a project: the main file and everything it includes
+// with \input, \include or \subfile. Each file is checked from the scan state
+// at the point where it is included, so open environments and braces, loaded
+// packages and defined commands carry across files as they do in LaTeX.
+//
+// Files are checked concurrently, one level of the include tree at a time,
+// assuming that an included file ends in the state it started from. A
+// sequential pass then follows the includes in document order and checks
+// again only the files where that assumption did not hold.
+//
+// Results are cached per file, keyed by modification time and content hash,
+// and kept in the cache directory between runs, so checking a project again
+// only reads and checks the files that changed.
+class LaTeXProjectLinter {
+public:
+    // Resolved path of every include, by including file and name as written
+    using IncludeMap = QHash<QString, QHash<QString, QString>>;
+
+    struct Result {
+        QVector<LaTeXError> errors;   // By file in include order, then by position
+        QStringList files;            // Files reached from the main file, in include order
+        int checkedFiles = 0;         // Files checked again; the others came from the cache
+    };
+
+    LaTeXProjectLinter();
+
+    // Resolves the includes of every project file; call on the model's thread
+    static IncludeMap includeMap(const ProjectModel &project);
+
+    // Not reentrant: one project at a time per linter
+    Result lint(const QString &mainFile, const IncludeMap &includes,
+                QThreadPool *pool = QThreadPool::globalInstance());
+    void clearCache();
+
+private:
+    using ScanState = LaTeXErrorChecker::ScanState;
+
+    struct Include {
+        QString file;
+        ScanState before;   // State the included file starts from
+        ScanState after;    // State the including file continued with
+    };
+
+    struct FileResult {
+        qint64 size = -1;   // -1 if there is no result
+        qint64 modified = 0;
+        QByteArray contentHash;
+        ScanState entry;
+        ScanState exit;
+        QVector<Include> includes;
+        QVector<LaTeXError> errors;
+        bool checked = false;   // Checked in this run, not taken from the cache
+    };
+
+    struct Pending {
+        QString file;
+        ScanState entry;
+        FileResult cached;
+    };
+
+    // State of one lint() call
+    struct Run {
+        const IncludeMap *includes;
+        QSet<QString> current;   // Results compared with the file on disk
+        QSet<QString> active;    // Files being followed, to stop include cycles
+        QStringList order;
+        QSet<QString> checked;   // Files not taken from the cache
+    };
+
+    // Checks one file unless 'cached' is still valid for it. 'included' may
+    // replace the state after each include; without it, includes are assumed
+    // to leave the state unchanged.
+    FileResult checkFile(const QString &path, const ScanState &entry, const FileResult &cached,
+                         const IncludeMap &includes,
+                         const LaTeXErrorChecker::IncludeCallback &included) const;
+    // Returns the state at the end of 'path' included with 'entry', checking
+    // it again if its result was found for another state
+    ScanState follow(const QString &path, const ScanState &entry, Run &run);
+
+    static QString resolve(const IncludeMap &includes, const QString &file, const QString &name);
+    void loadCache(const QString &path);
+    void saveCache() const;
+    static QString cachePath(const QString &mainFile);
+
+    // Created by the first lint(), so loading the command database does not
+    // delay whoever constructs the linter
+    std::unique_ptr<LaTeXErrorChecker> m_checker;
+    QHash<QString, FileResult> m_results;
+    QString m_cachePath;
+};
+
+#endif // LATEXPROJECTLINTER_H
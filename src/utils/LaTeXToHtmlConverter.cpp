@@ -1,303 +1,415 @@
 // LaTeXToHtmlConverter.cpp
 #include "LaTeXToHtmlConverter.h"
+#include "MathJaxLocator.h"
+#include "LaTeXBlockSplitter.h"
 #include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <QtConcurrent>
 #include <QCoreApplication>
 
-LaTeXToHtmlConverter::LaTeXToHtmlConverter() {
-    initializeSymbolMap();
-    initializeEnvironmentMap();
-}
+namespace {
 
-void LaTeXToHtmlConverter::initializeSymbolMap() {
-    // Common LaTeX special characters
-    m_symbolMap["---"] = "&mdash;";  // em dash
-    m_symbolMap["--"] = "&ndash;";   // en dash
-    m_symbolMap["``"] = "&ldquo;";   // left double quote
-    m_symbolMap["''"] = "&rdquo;";   // right double quote
-    m_symbolMap["`"] = "&lsquo;";    // left single quote (when alone)
-    m_symbolMap["'"] = "&rsquo;";    // right single quote (when alone)
-    m_symbolMap["~"] = "&nbsp;";     // non-breaking space
+LaTeXCommandRule replaceRule(const QString &html) {
+    LaTeXCommandRule rule;
+    rule.kind = LaTeXCommandRule::Replace;
+    rule.open = html;
+    return rule;
 }
 
-void LaTeXToHtmlConverter::initializeEnvironmentMap() {
-    m_environmentMap["abstract"] = "div class='abstract'";
-    m_environmentMap["quote"] = "blockquote";
-    m_environmentMap["quotation"] = "blockquote";
-    m_environmentMap["center"] = "div style='text-align: center;'";
-    m_environmentMap["flushleft"] = "div style='text-align: left;'";
-    m_environmentMap["flushright"] = "div style='text-align: right;'";
-    m_environmentMap["verbatim"] = "pre";
+LaTeXCommandRule wrapRule(const QString &open, const QString &close) {
+    LaTeXCommandRule rule;
+    rule.kind = LaTeXCommandRule::Wrap;
+    rule.open = open;
+    rule.close = close;
+    return rule;
 }
 
-QString LaTeXToHtmlConverter::convertToHtml(const QString &latexContent, bool useCdn) {
-    QString processed = latexContent;
-
-    // Process in order of complexity
-    processed = processDocumentStructure(processed);
-    processed = processVerbatim(processed);
-    processed = processSections(processed);
-    processed = processTextFormatting(processed);
-    processed = processLists(processed);
-    processed = processTables(processed);
-    processed = processEnvironments(processed);
-    processed = processSpecialCharacters(processed);
-    processed = processPackageCommands(processed);
-    processed = processReferences(processed);
-    processed = processMathEnvironments(processed);
-
-    return generateHtmlDocument(processed, useCdn);
+LaTeXCommandRule templateRule(const QString &html) {
+    LaTeXCommandRule rule;
+    rule.kind = LaTeXCommandRule::Template;
+    rule.open = html;
+    return rule;
 }
 
-QString LaTeXToHtmlConverter::processDocumentStructure(const QString &content) {
-    QString result = content;
+LaTeXCommandRule templateWrapRule(const QString &open, const QString &close,
+                                  const QStringList &allowedArguments = QStringList()) {
+    LaTeXCommandRule rule;
+    rule.kind = LaTeXCommandRule::TemplateWrap;
+    rule.open = open;
+    rule.close = close;
+    rule.allowedArguments = allowedArguments;
+    return rule;
+}
 
-    // Remove preamble commands
-    result.replace(QRegularExpression("\\\\documentclass(\\[.*?\\])?\\{.*?\\}"), "");
-    result.replace(QRegularExpression("\\\\usepackage(\\[.*?\\])?\\{.*?\\}"), "");
-    result.replace("\\begin{document}", "");
-    result.replace("\\end{document}", "");
+LaTeXCommandRule handlerRule(LaTeXCommandRule::HandlerId handler) {
+    LaTeXCommandRule rule;
+    rule.kind = LaTeXCommandRule::Handler;
+    rule.handler = handler;
+    return rule;
+}
 
-    // Process title, author, date
-    result.replace(QRegularExpression("\\\\title\\{([^}]+)\\}"), "<h1 class='title'>\\1</h1>");
-    result.replace(QRegularExpression("\\\\author\\{([^}]+)\\}"), "<div class='author'>\\1</div>");
-    result.replace(QRegularExpression("\\\\date\\{([^}]+)\\}"), "<div class='date'>\\1</div>");
-    result.replace("\\maketitle", "");
-    result.replace("\\tableofcontents", "<div class='toc'>[Table of Contents]</div>");
+LaTeXEnvironmentRule environmentRule(LaTeXEnvironmentRule::Kind kind,
+                                     const QString &open = QString(),
+                                     const QString &close = QString(),
+                                     bool skipOptional = false) {
+    LaTeXEnvironmentRule rule;
+    rule.kind = kind;
+    rule.open = open;
+    rule.close = close;
+    rule.skipOptional = skipOptional;
+    return rule;
+}
 
-    return result;
+// Chunks smaller than this are not worth a thread pool task
+constexpr qsizetype MinConcurrentChunkSize = 32 * 1024;
+
+// Whether a top-level block starts a new chunk for concurrent conversion
+bool startsChunk(QStringView block) {
+    const QStringView trimmed = block.trimmed();
+    static const QStringView chunkCommands[] = { u"\\part", u"\\chapter", u"\\section" };
+    for (QStringView command : chunkCommands) {
+        if (trimmed.startsWith(command)) {
+            const QStringView rest = trimmed.mid(command.size());
+            return rest.isEmpty() || !rest.at(0).isLetter();
+        }
+    }
+    return false;
 }
 
-QString LaTeXToHtmlConverter::processSections(const QString &content) {
-    QString result = content;
+} // namespace
 
-    // Section hierarchy with numbering support
-    result.replace(QRegularExpression("\\\\part\\{([^}]+)\\}"), "<h1 class='part'>\\1</h1>");
-    result.replace(QRegularExpression("\\\\chapter\\{([^}]+)\\}"), "<h1 class='chapter'>\\1</h1>");
-    result.replace(QRegularExpression("\\\\section\\{([^}]+)\\}"), "<h2>\\1</h2>");
-    result.replace(QRegularExpression("\\\\subsection\\{([^}]+)\\}"), "<h3>\\1</h3>");
-    result.replace(QRegularExpression("\\\\subsubsection\\{([^}]+)\\}"), "<h4>\\1</h4>");
-    result.replace(QRegularExpression("\\\\paragraph\\{([^}]+)\\}"), "<h5>\\1</h5>");
-    result.replace(QRegularExpression("\\\\subparagraph\\{([^}]+)\\}"), "<h6>\\1</h6>");
+LaTeXToHtmlConverter::LaTeXToHtmlConverter()
+    : m_tables(sharedTables())
+{
+}
 
-    // Starred versions (no numbering)
-    result.replace(QRegularExpression("\\\\section\\*\\{([^}]+)\\}"), "<h2>\\1</h2>");
-    result.replace(QRegularExpression("\\\\subsection\\*\\{([^}]+)\\}"), "<h3>\\1</h3>");
-    result.replace(QRegularExpression("\\\\subsubsection\\*\\{([^}]+)\\}"), "<h4>\\1</h4>");
+const LaTeXConversionTables &LaTeXToHtmlConverter::sharedTables() {
+    // Built once for the whole process; never modified afterwards
+    static const LaTeXConversionTables tables = []() {
+        LaTeXConversionTables result;
+        initializeSymbolMap(result);
+        initializeCommandMap(result);
+        initializeEnvironmentMap(result);
+        result.prepareSymbols();
+        return result;
+    }();
+    return tables;
+}
 
-    return result;
+void LaTeXToHtmlConverter::initializeSymbolMap(LaTeXConversionTables &tables) {
+    // Common LaTeX special characters
+    tables.symbols["---"] = "&mdash;";  // em dash
+    tables.symbols["--"] = "&ndash;";   // en dash
+    tables.symbols["``"] = "&ldquo;";   // left double quote
+    tables.symbols["''"] = "&rdquo;";   // right double quote
+    tables.symbols["`"] = "&lsquo;";    // left single quote (when alone)
+    tables.symbols["'"] = "&rsquo;";    // right single quote (when alone)
+    tables.symbols["~"] = "&nbsp;";     // non-breaking space
 }
 
-QString LaTeXToHtmlConverter::processTextFormatting(const QString &content) {
-    QString result = content;
+void LaTeXToHtmlConverter::initializeCommandMap(LaTeXConversionTables &tables) {
+    QHash<QString, LaTeXCommandRule> &commands = tables.commands;
+
+    // Preamble commands are dropped
+    commands["documentclass"] = templateRule("");
+    commands["usepackage"] = templateRule("");
+
+    // Title, author, date
+    commands["title"] = wrapRule("<h1 class='title'>", "</h1>");
+    commands["author"] = wrapRule("<div class='author'>", "</div>");
+    commands["date"] = wrapRule("<div class='date'>", "</div>");
+    commands["maketitle"] = replaceRule("");
+    commands["tableofcontents"] = replaceRule("<div class='toc'>[Table of Contents]</div>");
+
+    // Section hierarchy (starred versions are accepted by the emitter)
+    commands["part"] = wrapRule("<h1 class='part'>", "</h1>");
+    commands["chapter"] = wrapRule("<h1 class='chapter'>", "</h1>");
+    commands["section"] = wrapRule("<h2>", "</h2>");
+    commands["subsection"] = wrapRule("<h3>", "</h3>");
+    commands["subsubsection"] = wrapRule("<h4>", "</h4>");
+    commands["paragraph"] = wrapRule("<h5>", "</h5>");
+    commands["subparagraph"] = wrapRule("<h6>", "</h6>");
 
     // Font styles
-    result.replace(QRegularExpression("\\\\textbf\\{([^}]+)\\}"), "<strong>\\1</strong>");
-    result.replace(QRegularExpression("\\\\textit\\{([^}]+)\\}"), "<em>\\1</em>");
-    result.replace(QRegularExpression("\\\\emph\\{([^}]+)\\}"), "<em>\\1</em>");
-    result.replace(QRegularExpression("\\\\texttt\\{([^}]+)\\}"), "<code>\\1</code>");
-    result.replace(QRegularExpression("\\\\textsc\\{([^}]+)\\}"), "<span style='font-variant: small-caps;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\underline\\{([^}]+)\\}"), "<u>\\1</u>");
+    commands["textbf"] = wrapRule("<strong>", "</strong>");
+    commands["textit"] = wrapRule("<em>", "</em>");
+    commands["emph"] = wrapRule("<em>", "</em>");
+    commands["texttt"] = wrapRule("<code>", "</code>");
+    commands["textsc"] = wrapRule("<span style='font-variant: small-caps;'>", "</span>");
+    commands["underline"] = wrapRule("<u>", "</u>");
 
     // Font sizes
-    result.replace(QRegularExpression("\\\\tiny\\{([^}]+)\\}"), "<span style='font-size: 0.6em;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\small\\{([^}]+)\\}"), "<span style='font-size: 0.9em;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\large\\{([^}]+)\\}"), "<span style='font-size: 1.2em;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\Large\\{([^}]+)\\}"), "<span style='font-size: 1.5em;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\LARGE\\{([^}]+)\\}"), "<span style='font-size: 1.8em;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\huge\\{([^}]+)\\}"), "<span style='font-size: 2em;'>\\1</span>");
-
-    // Colors (basic support)
-    result.replace(QRegularExpression("\\\\textcolor\\{red\\}\\{([^}]+)\\}"), "<span style='color: red;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\textcolor\\{blue\\}\\{([^}]+)\\}"), "<span style='color: blue;'>\\1</span>");
-    result.replace(QRegularExpression("\\\\textcolor\\{green\\}\\{([^}]+)\\}"), "<span style='color: green;'>\\1</span>");
+    commands["tiny"] = wrapRule("<span style='font-size: 0.6em;'>", "</span>");
+    commands["small"] = wrapRule("<span style='font-size: 0.9em;'>", "</span>");
+    commands["large"] = wrapRule("<span style='font-size: 1.2em;'>", "</span>");
+    commands["Large"] = wrapRule("<span style='font-size: 1.5em;'>", "</span>");
+    commands["LARGE"] = wrapRule("<span style='font-size: 1.8em;'>", "</span>");
+    commands["huge"] = wrapRule("<span style='font-size: 2em;'>", "</span>");
+
+    // Colors (basic support, other colors are left as they are)
+    commands["textcolor"] = templateWrapRule("<span style='color: %1;'>", "</span>",
+                                             QStringList() << "red" << "blue" << "green");
 
     // Spacing commands
-    result.replace("\\\\", "<br>");  // Line break
-    result.replace("\\par", "<p>");   // Paragraph break
-    result.replace("\\newpage", "<hr style='page-break-after: always;'>");
-    result.replace("\\clearpage", "<hr style='page-break-after: always;'>");
+    commands["\\"] = handlerRule(LaTeXCommandRule::LineBreak);
+    commands["par"] = replaceRule("<p>");
+    commands["newpage"] = replaceRule("<hr style='page-break-after: always;'>");
+    commands["clearpage"] = replaceRule("<hr style='page-break-after: always;'>");
 
-    return result;
-}
+    // Environments and lists
+    commands["begin"] = handlerRule(LaTeXCommandRule::Begin);
+    commands["end"] = handlerRule(LaTeXCommandRule::End);
+    commands["item"] = handlerRule(LaTeXCommandRule::Item);
 
-QString LaTeXToHtmlConverter::processLists(const QString &content) {
-    QString result = content;
+    // Tables and figures
+    commands["hline"] = replaceRule("");
+    commands["caption"] = wrapRule("<div class='caption'>", "</div>");
+    commands["includegraphics"] = templateRule("<img src='%1' alt='%1' style='max-width: 100%;'>");
 
-    // Lists
-    result.replace("\\begin{itemize}", "<ul>");
-    result.replace("\\end{itemize}", "</ul>");
-    result.replace("\\begin{enumerate}", "<ol>");
-    result.replace("\\end{enumerate}", "</ol>");
-    result.replace("\\begin{description}", "<dl>");
-    result.replace("\\end{description}", "</dl>");
-
-    // List items
-    result.replace(QRegularExpression("\\\\item\\s+"), "<li>");
-    result.replace(QRegularExpression("\\\\item\\[([^\\]]+)\\]\\s*"), "<dt>\\1</dt><dd>");
-
-    return result;
-}
+    // LaTeX special characters
+    commands["&"] = replaceRule("&amp;");
+    commands["%"] = replaceRule("%");
+    commands["$"] = replaceRule("$");
+    commands["#"] = replaceRule("#");
+    commands["_"] = replaceRule("_");
+    commands["{"] = replaceRule("{");
+    commands["}"] = replaceRule("}");
 
-QString LaTeXToHtmlConverter::processTables(const QString &content) {
-    QString result = content;
+    // Quotes
+    commands["textquotedblleft"] = replaceRule("&ldquo;");
+    commands["textquotedblright"] = replaceRule("&rdquo;");
 
-    // Basic table support
-    QRegularExpression tableRegex("\\\\begin\\{tabular\\}(\\{[^}]+\\})([\\s\\S]*?)\\\\end\\{tabular\\}");
-    QRegularExpressionMatchIterator it = tableRegex.globalMatch(content);
+    // Hyperref package
+    commands["href"] = templateWrapRule("<a href='%1' target='_blank'>", "</a>");
+    commands["url"] = templateRule("<a href='%1' target='_blank'>%1</a>");
 
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        QString tableContent = match.captured(2);
+    // Citations and cross references
+    commands["cite"] = templateRule("[<a href='#ref-%1'>%1</a>]");
+    commands["ref"] = templateRule("<a href='#%1'>?</a>");
+    commands["label"] = templateRule("<a name='%1'></a>");
 
-        // Convert rows
-        QStringList rows = tableContent.split("\\\\");
-        QString htmlTable = "<table border='1' cellpadding='5' cellspacing='0'>";
+    // Footnotes
+    commands["footnote"] = wrapRule("<sup><a href='#fn'>*</a></sup><span class='footnote'>", "</span>");
 
-        for (const QString &row : rows) {
-            if (row.trimmed().isEmpty()) continue;
+    // Verbatim and math, passed through raw
+    commands["verb"] = handlerRule(LaTeXCommandRule::Verb);
+    commands["("] = handlerRule(LaTeXCommandRule::InlineMath);
+    commands["["] = handlerRule(LaTeXCommandRule::DisplayMath);
+}
 
-            QString cleanRow = row.trimmed();
-            cleanRow.replace("\\hline", "");  // Remove hlines
+void LaTeXToHtmlConverter::initializeEnvironmentMap(LaTeXConversionTables &tables) {
+    QHash<QString, LaTeXEnvironmentRule> &environments = tables.environments;
 
-            QStringList cells = cleanRow.split("&");
-            htmlTable += "<tr>";
-            for (const QString &cell : cells) {
-                htmlTable += "<td>" + cell.trimmed() + "</td>";
-            }
-            htmlTable += "</tr>";
-        }
+    environments["document"] = environmentRule(LaTeXEnvironmentRule::Ignore);
 
-        htmlTable += "</table>";
-        result.replace(match.captured(0), htmlTable);
-    }
+    environments["abstract"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<div class='abstract'>", "</div>");
+    environments["quote"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<blockquote>", "</blockquote>");
+    environments["quotation"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<blockquote>", "</blockquote>");
+    environments["center"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<div style='text-align: center;'>", "</div>");
+    environments["flushleft"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<div style='text-align: left;'>", "</div>");
+    environments["flushright"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<div style='text-align: right;'>", "</div>");
+    environments["verbatim"] = environmentRule(LaTeXEnvironmentRule::Verbatim, "<pre>", "</pre>");
 
-    // Table environment
-    result.replace(QRegularExpression("\\\\begin\\{table\\}(\\[.*?\\])?"), "<div class='table'>");
-    result.replace("\\end{table}", "</div>");
-    result.replace(QRegularExpression("\\\\caption\\{([^}]+)\\}"), "<div class='caption'>\\1</div>");
+    // Lists
+    environments["itemize"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<ul>", "</ul>");
+    environments["enumerate"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<ol>", "</ol>");
+    environments["description"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<dl>", "</dl>");
 
-    return result;
+    // Theorem-like environments
+    environments["theorem"] = environmentRule(LaTeXEnvironmentRule::Wrap,
+                                              "<div class='theorem'><strong>Theorem.</strong> ", "</div>");
+    environments["lemma"] = environmentRule(LaTeXEnvironmentRule::Wrap,
+                                            "<div class='lemma'><strong>Lemma.</strong> ", "</div>");
+    environments["proof"] = environmentRule(LaTeXEnvironmentRule::Wrap,
+                                            "<div class='proof'><em>Proof.</em> ", " ∎</div>");
+
+    // Floats (placement options are dropped)
+    environments["figure"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<figure>", "</figure>", true);
+    environments["table"] = environmentRule(LaTeXEnvironmentRule::Wrap, "<div class='table'>", "</div>", true);
+    environments["tabular"] = environmentRule(LaTeXEnvironmentRule::Tabular);
+
+    // Equation environments become display math
+    environments["equation"] = environmentRule(LaTeXEnvironmentRule::Equation);
+    environments["equation*"] = environmentRule(LaTeXEnvironmentRule::Equation);
+
+    // Environments MathJax understands are kept as-is
+    const QStringList mathEnvironments = {
+        "align", "align*", "gather", "gather*", "multline", "multline*",
+        "flalign", "flalign*", "eqnarray", "eqnarray*"
+    };
+    for (const QString &name : mathEnvironments) {
+        environments[name] = environmentRule(LaTeXEnvironmentRule::Math);
+    }
 }
 
-QString LaTeXToHtmlConverter::processEnvironments(const QString &content) {
-    QString result = content;
+QString LaTeXToHtmlConverter::convertToHtml(const QString &latexContent, bool useCdn) {
+    return generateHtmlDocument(convertBodyConcurrent(latexContent), useCdn);
+}
 
-    // Process custom environments
-    for (auto it = m_environmentMap.begin(); it != m_environmentMap.end(); ++it) {
-        QString env = it.key();
-        QString html = it.value();
+bool LaTeXToHtmlConverter::convertToHtml(QIODevice *input, QIODevice *output, bool useCdn) {
+    if (!input || !input->isReadable() || !output || !output->isWritable()) {
+        qWarning() << "Streaming conversion needs readable input and writable output devices";
+        return false;
+    }
 
-        result.replace("\\begin{" + env + "}", "<" + html + ">");
-        result.replace("\\end{" + env + "}", "</" + html.split(' ').first() + ">");
+    QTextStream in(input);
+    QTextStream out(output);
+    out << documentHead(useCdn);
+
+    // Lines are collected until the splitter reports the start of the next block.
+    // A block that depends on the text after it stays pending and is converted
+    // again once the pending text has doubled. The buffers keep their capacity
+    // between blocks.
+    LaTeXHtmlEmitter emitter(m_tables);
+    LaTeXBlockSplitter splitter;
+    QString line;
+    QString block;
+    QString html;
+    qsizetype retrySize = 1;
+
+    auto writeBlock = [&]() {
+        out << html;
+        html.resize(0);
+        block.resize(0);
+        retrySize = 1;
+    };
+
+    while (in.readLineInto(&line)) {
+        if (splitter.startsBlock(line) && block.size() >= retrySize) {
+            if (emitter.convert(block, html)) {
+                writeBlock();
+            } else {
+                html.resize(0);
+                retrySize = 2 * block.size();
+            }
+        }
+        block += line;
+        block += QLatin1Char('\n');
+    }
+    if (!block.isEmpty()) {
+        emitter.convert(block, html);
+        writeBlock();
     }
 
-    // Theorem-like environments
-    result.replace(QRegularExpression("\\\\begin\\{theorem\\}"), "<div class='theorem'><strong>Theorem.</strong> ");
-    result.replace("\\end{theorem}", "</div>");
-    result.replace(QRegularExpression("\\\\begin\\{lemma\\}"), "<div class='lemma'><strong>Lemma.</strong> ");
-    result.replace("\\end{lemma}", "</div>");
-    result.replace(QRegularExpression("\\\\begin\\{proof\\}"), "<div class='proof'><em>Proof.</em> ");
-    result.replace("\\end{proof}", " ∎</div>");
-
-    // Figure environment
-    result.replace(QRegularExpression("\\\\begin\\{figure\\}(\\[.*?\\])?"), "<figure>");
-    result.replace("\\end{figure}", "</figure>");
-    result.replace(QRegularExpression("\\\\includegraphics(\\[.*?\\])?\\{([^}]+)\\}"),
-                   "<img src='\\2' alt='\\2' style='max-width: 100%;'>");
-
-    return result;
+    out << documentTail();
+    out.flush();
+    return out.status() == QTextStream::Ok;
 }
 
-QString LaTeXToHtmlConverter::processSpecialCharacters(const QString &content) {
-    QString result = content;
-
-    // Process symbol map
-    for (auto it = m_symbolMap.begin(); it != m_symbolMap.end(); ++it) {
-        result.replace(it.key(), it.value());
+bool LaTeXToHtmlConverter::convertToHtml(QStringView latexContent, QIODevice *output, bool useCdn) {
+    if (!output || !output->isWritable()) {
+        qWarning() << "Streaming conversion needs a writable output device";
+        return false;
     }
 
-    // LaTeX special characters
-    result.replace("\\&", "&amp;");
-    result.replace("\\%", "%");
-    result.replace("\\$", "$");
-    result.replace("\\#", "#");
-    result.replace("\\_", "_");
-    result.replace("\\{", "{");
-    result.replace("\\}", "}");
-
-    // Quotes
-    result.replace("\\textquotedblleft", "&ldquo;");
-    result.replace("\\textquotedblright", "&rdquo;");
+    QTextStream out(output);
+    out << documentHead(useCdn);
+
+    // As above, a block that depends on the text after it is converted
+    // together with the following blocks, doubling their number each time
+    LaTeXHtmlEmitter emitter(m_tables);
+    QString html;
+    const QVector<LaTeXBlockSplitter::Block> blocks = LaTeXBlockSplitter::split(latexContent);
+    qsizetype first = 0;
+    qsizetype count = 1;
+    while (first < blocks.size()) {
+        const qsizetype last = qMin(first + count, blocks.size()) - 1;
+        const qsizetype start = blocks[first].start;
+        const qsizetype end = blocks[last].start + blocks[last].length;
+        if (emitter.convert(latexContent.mid(start, end - start), html) || last == blocks.size() - 1) {
+            out << html;
+            first = last + 1;
+            count = 1;
+        } else {
+            count *= 2;
+        }
+        html.resize(0);
+    }
 
-    return result;
+    out << documentTail();
+    out.flush();
+    return out.status() == QTextStream::Ok;
 }
 
-QString LaTeXToHtmlConverter::processPackageCommands(const QString &content) {
-    QString result = content;
-
-    // Hyperref package
-    result.replace(QRegularExpression("\\\\href\\{([^}]+)\\}\\{([^}]+)\\}"),
-                   "<a href='\\1' target='_blank'>\\2</a>");
-    result.replace(QRegularExpression("\\\\url\\{([^}]+)\\}"),
-                   "<a href='\\1' target='_blank'>\\1</a>");
-
-    return result;
+QString LaTeXToHtmlConverter::convertBody(QStringView latexContent) const {
+    LaTeXHtmlEmitter emitter(m_tables);
+    return emitter.convert(latexContent);
 }
 
-QString LaTeXToHtmlConverter::processReferences(const QString &content) {
-    QString result = content;
-
-    // Citations
-    result.replace(QRegularExpression("\\\\cite\\{([^}]+)\\}"), "[<a href='#ref-\\1'>\\1</a>]");
-    result.replace(QRegularExpression("\\\\ref\\{([^}]+)\\}"), "<a href='#\\1'>?</a>");
-    result.replace(QRegularExpression("\\\\label\\{([^}]+)\\}"), "<a name='\\1'></a>");
-
-    // Footnotes
-    result.replace(QRegularExpression("\\\\footnote\\{([^}]+)\\}"),
-                   "<sup><a href='#fn'>*</a></sup><span class='footnote'>\\1</span>");
-
-    return result;
+bool LaTeXToHtmlConverter::convertBlock(QStringView block, QString &html) const {
+    LaTeXHtmlEmitter emitter(m_tables);
+    return emitter.convert(block, html);
 }
 
-QString LaTeXToHtmlConverter::processMathEnvironments(const QString &content) {
-    // Math environments are left as-is for MathJax to process
-    // Just ensure they're properly formatted
-    QString result = content;
-
-    // Equation environments
-    result.replace("\\begin{equation}", "\\[");
-    result.replace("\\end{equation}", "\\]");
-    result.replace("\\begin{equation*}", "\\[");
-    result.replace("\\end{equation*}", "\\]");
-
-    // Align environments (MathJax supports these)
-    // Keep as-is
+QString LaTeXToHtmlConverter::convertBodyConcurrent(QStringView latexContent) const {
+    if (latexContent.size() < 2 * MinConcurrentChunkSize) {
+        return convertBody(latexContent);
+    }
 
-    return result;
-}
+    // Chunks start at a top-level block, so a chunk that leaves nothing open
+    // converts to the same HTML on its own as within the whole document
+    QVector<QStringView> chunks;
+    qsizetype chunkStart = 0;
+    const QVector<LaTeXBlockSplitter::Block> blocks = LaTeXBlockSplitter::split(latexContent);
+    for (const LaTeXBlockSplitter::Block &block : blocks) {
+        if (block.start - chunkStart >= MinConcurrentChunkSize
+            && startsChunk(latexContent.mid(block.start, block.length))) {
+            chunks.append(latexContent.mid(chunkStart, block.start - chunkStart));
+            chunkStart = block.start;
+        }
+    }
+    chunks.append(latexContent.mid(chunkStart));
 
-QString LaTeXToHtmlConverter::processVerbatim(const QString &content) {
-    QString result = content;
+    if (chunks.size() == 1) {
+        return convertBody(latexContent);
+    }
 
-    // Verb command
-    QRegularExpression verbRegex("\\\\verb\\|([^|]+)\\|");
-    result.replace(verbRegex, "<code>\\1</code>");
+    struct ChunkResult {
+        QString html;
+        bool selfContained = true;
+    };
+
+    // The tables are immutable, so every task only needs its own emitter
+    const LaTeXConversionTables &tables = m_tables;
+    const QVector<ChunkResult> results = QtConcurrent::blockingMapped<QVector<ChunkResult>>(
+        chunks, [&tables](QStringView chunk) {
+            LaTeXHtmlEmitter emitter(tables);
+            ChunkResult result;
+            result.selfContained = emitter.convert(chunk, result.html);
+            return result;
+        });
+
+    qsizetype size = 0;
+    for (const ChunkResult &result : results) {
+        size += result.html.size();
+    }
 
-    return result;
+    QString body;
+    body.reserve(size);
+    for (qsizetype i = 0; i < results.size(); ++i) {
+        if (!results[i].selfContained && i < results.size() - 1) {
+            // A group, table or argument stays open into the next chunk, so
+            // the rest of the document is converted serially
+            const qsizetype restStart = chunks[i].data() - latexContent.data();
+            LaTeXHtmlEmitter emitter(m_tables);
+            emitter.convert(latexContent.mid(restStart), body);
+            break;
+        }
+        body += results[i].html;
+    }
+    return body;
 }
 
 QString LaTeXToHtmlConverter::getMathJaxConfig(bool useCdn) {
-    QString cdnScript = R"(
-    <script src="https://polyfill.io/v3/polyfill.min.js?features=es6"></script>
-    <script id="MathJax-script" async src="https://cdn.jsdelivr.net/npm/mathjax@3/es5/tex-mml-chtml.js"></script>
-)";
-
-    QString localScript = R"(
-    <script>
-        // MathJax would be loaded from local file if available
-        // For now, fallback to CDN or basic rendering
-    </script>
-)";
+    // A local or bundled copy is preferred; the CDN is only a fallback
+    const MathJaxLocation location = MathJaxLocator::locate(useCdn);
+    QString script;
+    if (!location.scriptUrl.isEmpty()) {
+        script = QString(R"(
+    <script id="MathJax-script" async src="%1"></script>
+)").arg(location.scriptUrl.toString(QUrl::FullyEncoded));
+    }
 
     return QString(R"(
     <script>
@@ -321,201 +433,62 @@ QString LaTeXToHtmlConverter::getMathJaxConfig(bool useCdn) {
             }
         };
     </script>
-)") + (useCdn ? cdnScript : localScript);
+)") + script;
 }
 
 QString LaTeXToHtmlConverter::getStyles() {
-    return R"(
-        <style>
-            body {
-                font-family: 'Libertine', 'Linux Libertine', 'Georgia', 'Times New Roman', serif;
-                max-width: 850px;
-                margin: 20px auto;
-                padding: 30px;
-                line-height: 1.7;
-                background: #ffffff;
-                color: #2d2d2d;
-                font-size: 16px;
-            }
-
-            /* Headings */
-            h1, h2, h3, h4, h5, h6 {
-                font-family: 'Libertine', 'Linux Libertine', 'Georgia', serif;
-                font-weight: bold;
-                margin-top: 1.5em;
-                margin-bottom: 0.8em;
-                color: #1a1a1a;
-            }
-            h1 { font-size: 2.2em; text-align: center; }
-            h1.title { margin-bottom: 0.3em; }
-            h2 { font-size: 1.75em; border-bottom: 2px solid #e0e0e0; padding-bottom: 0.3em; }
-            h3 { font-size: 1.4em; }
-            h4 { font-size: 1.2em; }
-            h5 { font-size: 1.1em; }
-            h6 { font-size: 1em; font-style: italic; }
-
-            /* Title page elements */
-            .title { margin-bottom: 0.5em; }
-            .author {
-                text-align: center;
-                font-size: 1.3em;
-                margin: 0.5em 0;
-                font-style: italic;
-            }
-            .date {
-                text-align: center;
-                color: #666;
-                margin: 0.5em 0 2em 0;
-            }
-
-            /* Text formatting */
-            p { margin: 1em 0; text-align: justify; }
-            strong { font-weight: bold; }
-            em { font-style: italic; }
-            code {
-                background: #f5f5f5;
-                padding: 2px 6px;
-                border-radius: 3px;
-                font-family: 'Courier New', Courier, monospace;
-                font-size: 0.9em;
-                border: 1px solid #e0e0e0;
-            }
-            pre {
-                background: #f8f8f8;
-                padding: 15px;
-                border-radius: 5px;
-                overflow-x: auto;
-                border: 1px solid #ddd;
-                line-height: 1.4;
-            }
-
-            /* Lists */
-            ul, ol {
-                margin: 1em 0;
-                padding-left: 2.5em;
-            }
-            li {
-                margin: 0.5em 0;
-                line-height: 1.6;
-            }
-            dl { margin: 1em 0; }
-            dt { font-weight: bold; margin-top: 0.5em; }
-            dd { margin-left: 2em; margin-bottom: 0.5em; }
-
-            /* Tables */
-            table {
-                border-collapse: collapse;
-                margin: 1.5em auto;
-                min-width: 50%;
-            }
-            td, th {
-                border: 1px solid #ddd;
-                padding: 8px 12px;
-                text-align: left;
-            }
-            th {
-                background-color: #f5f5f5;
-                font-weight: bold;
-            }
-            .caption {
-                text-align: center;
-                font-size: 0.9em;
-                font-style: italic;
-                margin: 0.5em 0;
-            }
-
-            /* Environments */
-            .abstract {
-                margin: 2em auto;
-                max-width: 90%;
-                padding: 1em;
-                background: #f9f9f9;
-                border-left: 4px solid #4CAF50;
-            }
-            blockquote {
-                margin: 1.5em 2em;
-                padding: 1em;
-                background: #f9f9f9;
-                border-left: 4px solid #ccc;
-                font-style: italic;
-            }
-            .theorem, .lemma, .proof {
-                margin: 1.5em 0;
-                padding: 1em;
-                background: #f0f7ff;
-                border-left: 4px solid #2196F3;
-            }
-            .proof {
-                background: #f5f5f5;
-                border-left: 4px solid #999;
-            }
-
-            /* Figures */
-            figure {
-                margin: 2em auto;
-                text-align: center;
-            }
-            figure img {
-                max-width: 100%;
-                height: auto;
-            }
-
-            /* Links */
-            a {
-                color: #0066cc;
-                text-decoration: none;
-            }
-            a:hover {
-                text-decoration: underline;
-            }
-
-            /* Math */
-            .mjx-math {
-                font-size: 1.05em;
-            }
-
-            /* Footnotes */
-            .footnote {
-                font-size: 0.85em;
-                color: #666;
-                display: block;
-                margin-top: 0.5em;
-                padding-left: 1em;
-            }
-        </style>
-    )";
+    // Read from the resources once per process
+    static const QString styles = []() {
+        QFile file(QStringLiteral(":/preview/preview.css"));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "Preview stylesheet not found in resources";
+            return QString();
+        }
+        return QString::fromUtf8(file.readAll());
+    }();
+    return styles;
 }
 
-QString LaTeXToHtmlConverter::generateHtmlDocument(const QString &body, bool useCdn) {
-    return QString(R"(
-<!DOCTYPE html>
+const QString &LaTeXToHtmlConverter::documentHead(bool useCdn) {
+    // The head only depends on where MathJax comes from, so it is built once
+    QString &head = useCdn ? m_cdnHead : m_localHead;
+    if (head.isEmpty()) {
+        head = QLatin1String(R"(<!DOCTYPE html>
 <html lang="en">
 <head>
     <meta charset="utf-8">
     <meta name="viewport" content="width=device-width, initial-scale=1.0">
     <title>LaTeX Preview</title>
-    %1
-    %2
-</head>
-<body>
-%3
-</body>
-</html>
-)").arg(getMathJaxConfig(useCdn), getStyles(), body);
+)");
+        head += getMathJaxConfig(useCdn);
+        head += QLatin1String("    <style>\n");
+        head += getStyles();
+        head += QLatin1String("    </style>\n</head>\n<body>\n");
+    }
+    return head;
+}
+
+QLatin1String LaTeXToHtmlConverter::documentTail() {
+    return QLatin1String("\n</body>\n</html>\n");
+}
+
+QString LaTeXToHtmlConverter::generateHtmlDocument(const QString &body, bool useCdn) {
+    const QString &head = documentHead(useCdn);
+    const QLatin1String tail = documentTail();
+
+    // Assemble into one preallocated buffer instead of substituting with arg()
+    QString html;
+    html.reserve(head.size() + body.size() + tail.size());
+    html += head;
+    html += body;
+    html += tail;
+    return html;
 }
 
-QString LaTeXToHtmlConverter::escapeHtml(const QString &text) {
-    QString result = text;
-    result.replace("&", "&amp;");
-    result.replace("<", "&lt;");
-    result.replace(">", "&gt;");
-    result.replace("\"", "&quot;");
-    result.replace("'", "&#39;");
-    return result;
+QString LaTeXToHtmlConverter::generatePreviewShell(bool useCdn) {
+    return generateHtmlDocument(previewContainer(), useCdn);
 }
 
-QString LaTeXToHtmlConverter::replaceCommand(const QString &content, const QString &command, const QString &htmlTag) {
-    QString pattern = "\\\\" + command + "\\{([^}]+)\\}";
-    QString replacement = "<" + htmlTag + ">\\1</" + htmlTag + ">";
-    return QString(content).replace(QRegularExpression(pattern), replacement);
+QString LaTeXToHtmlConverter::previewContainer(const QString &content) {
+    return QLatin1String("<div id=\"latex-preview-blocks\">") + content + QLatin1String("</div>");
 }
@@ -3,8 +3,9 @@
 #define LATEXTOHTMLCONVERTER_H
 
 #include <QString>
-#include <QMap>
-#include <QRegularExpression>
+#include <QStringView>
+#include <QIODevice>
+#include "LaTeXHtmlEmitter.h"
 
 class LaTeXToHtmlConverter {
 public:
@@ -13,35 +14,56 @@ public:
     // Main conversion method
     QString convertToHtml(const QString &latexContent, bool useCdn = false);
 
-private:
-    // Individual conversion methods
-    QString processDocumentStructure(const QString &content);
-    QString processSections(const QString &content);
-    QString processTextFormatting(const QString &content);
-    QString processLists(const QString &content);
-    QString processTables(const QString &content);
-    QString processEnvironments(const QString &content);
-    QString processSpecialCharacters(const QString &content);
-    QString processPackageCommands(const QString &content);
-    QString processReferences(const QString &content);
-    QString processMathEnvironments(const QString &content);
-    QString processVerbatim(const QString &content);
+    // Streaming conversion: each top-level block is converted and written as
+    // soon as it is complete, so memory is bounded by the largest block rather
+    // than the document. Blocks that leave a group, table or argument open are
+    // held back and converted with the blocks after them, so the output is the
+    // same as convertToHtml (with line ends read from a device taken as "\n").
+    // Both devices must be open. Returns false on write errors.
+    bool convertToHtml(QIODevice *input, QIODevice *output, bool useCdn = false);
+    bool convertToHtml(QStringView latexContent, QIODevice *output, bool useCdn = false);
 
-    // HTML generation
+    // Converts LaTeX to the HTML body only, in a single pass over the source
+    QString convertBody(QStringView latexContent) const;
+
+    // Appends the HTML of one top-level block to 'html'. Returns false if the
+    // block depends on the text after it, for example a heading argument that
+    // does not close in the block; it must then be converted together with the
+    // following blocks to give the same HTML as convertBody.
+    bool convertBlock(QStringView block, QString &html) const;
+
+    // Same result as convertBody. Long documents are split at \part, \chapter
+    // and \section and the chunks are converted on the global thread pool.
+    // From the first chunk that leaves a group, table or argument open into
+    // the next one, the rest of the document is converted serially.
+    QString convertBodyConcurrent(QStringView latexContent) const;
+
+    // Wraps a converted body in the preview page (MathJax setup and styles)
     QString generateHtmlDocument(const QString &body, bool useCdn);
+
+    // Preview page whose body is an empty block container. The preview window
+    // fills the container with converted blocks and patches it on later updates.
+    QString generatePreviewShell(bool useCdn);
+    static QString previewContainer(const QString &content = QString());
+
+private:
+    // HTML generation
     QString getMathJaxConfig(bool useCdn);
-    QString getStyles();
+    static QString getStyles();
+    const QString &documentHead(bool useCdn);
+    static QLatin1String documentTail();
 
-    // Helper methods
-    QString escapeHtml(const QString &text);
-    QString replaceCommand(const QString &content, const QString &command, const QString &htmlTag);
+    // Everything up to <body>, built on first use
+    QString m_cdnHead;
+    QString m_localHead;
 
-    // Conversion maps
-    QMap<QString, QString> m_symbolMap;
-    QMap<QString, QString> m_environmentMap;
+    // Conversion tables used by the emitter, shared by all converters
+    static const LaTeXConversionTables &sharedTables();
+    const LaTeXConversionTables &m_tables;
 
-    void initializeSymbolMap();
-    void initializeEnvironmentMap();
+    static void initializeSymbolMap(LaTeXConversionTables &tables);
+    static void initializeCommandMap(LaTeXConversionTables &tables);
+    static void initializeEnvironmentMap(LaTeXConversionTables &tables);
 };
 
 #endif // LATEXTOHTMLCONVERTER_H
@@ -0,0 +1,316 @@
+// LaTeXTokenizer.cpp
+#include "LaTeXTokenizer.h"
+#include "LaTeXCharScanner.h"
+
+namespace {
+
+// Characters that end a text run
+const LaTeXCharScanner &specialScanner() {
+    static const LaTeXCharScanner scanner(QLatin1String("\\{}[]$&%\n"));
+    return scanner;
+}
+
+const LaTeXCharScanner &newlineScanner() {
+    static const LaTeXCharScanner scanner(QLatin1String("\n"));
+    return scanner;
+}
+
+inline bool isAsciiLetter(char16_t ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+} // namespace
+
+LaTeXTokenizer::LaTeXTokenizer(QStringView input, int firstLine)
+    : m_input(input)
+    , m_pos(0)
+    , m_line(firstLine)
+    , m_lineStart(0)
+    , m_reachedEnd(false)
+{
+}
+
+void LaTeXTokenizer::reset(const Mark &mark) {
+    m_pos = mark.pos;
+    m_line = mark.line;
+    m_lineStart = mark.lineStart;
+}
+
+void LaTeXTokenizer::advanceTo(qsizetype pos) {
+    const char16_t *data = m_input.utf16();
+    for (qsizetype i = m_pos; (i = newlineScanner().indexIn(data, i, pos)) < pos; ++i) {
+        ++m_line;
+        m_lineStart = i + 1;
+    }
+    m_pos = pos;
+}
+
+LaTeXToken LaTeXTokenizer::next() {
+    LaTeXToken token;
+    token.position = m_pos;
+    token.line = m_line;
+    token.column = static_cast<int>(m_pos - m_lineStart);
+
+    const qsizetype size = m_input.size();
+    if (m_pos >= size) {
+        token.type = LaTeXToken::End;
+        return token;
+    }
+
+    const char16_t *data = m_input.utf16();
+    const char16_t ch = data[m_pos];
+
+    switch (ch) {
+        case '\\': {
+            qsizetype end = m_pos + 1;
+            while (end < size && isAsciiLetter(data[end])) {
+                ++end;
+            }
+            if (end == m_pos + 1 && end < size) {
+                ++end; // Control symbol such as \\ or \{
+            }
+            if (end >= size) {
+                m_reachedEnd = true;
+            }
+            token.type = LaTeXToken::Command;
+            token.text = m_input.mid(m_pos + 1, end - m_pos - 1);
+            advanceTo(end);
+            return token;
+        }
+        case '{':
+            token.type = LaTeXToken::BeginGroup;
+            break;
+        case '}':
+            token.type = LaTeXToken::EndGroup;
+            break;
+        case '[':
+            token.type = LaTeXToken::BeginOptional;
+            break;
+        case ']':
+            token.type = LaTeXToken::EndOptional;
+            break;
+        case '&':
+            token.type = LaTeXToken::Alignment;
+            break;
+        case '$':
+            if (m_pos + 1 >= size) {
+                m_reachedEnd = true;
+            } else if (data[m_pos + 1] == '$') {
+                token.type = LaTeXToken::DisplayMathShift;
+                token.text = m_input.mid(m_pos, 2);
+                m_pos += 2;
+                return token;
+            }
+            token.type = LaTeXToken::MathShift;
+            break;
+        case '%': {
+            const qsizetype end = newlineScanner().indexIn(data, m_pos + 1, size);
+            if (end >= size) {
+                m_reachedEnd = true;
+            }
+            token.type = LaTeXToken::Comment;
+            token.text = m_input.mid(m_pos + 1, end - m_pos - 1);
+            m_pos = end;
+            return token;
+        }
+        case '\n':
+            token.type = LaTeXToken::Newline;
+            token.text = m_input.mid(m_pos, 1);
+            ++m_pos;
+            ++m_line;
+            m_lineStart = m_pos;
+            return token;
+        default: {
+            const qsizetype end = specialScanner().indexIn(data, m_pos + 1, size);
+            if (end >= size) {
+                m_reachedEnd = true;
+            }
+            token.type = LaTeXToken::Text;
+            token.text = m_input.mid(m_pos, end - m_pos);
+            m_pos = end;
+            return token;
+        }
+    }
+
+    // Single character tokens
+    token.text = m_input.mid(m_pos, 1);
+    ++m_pos;
+    return token;
+}
+
+void LaTeXTokenizer::skipSpaces() {
+    const char16_t *data = m_input.utf16();
+    while (m_pos < m_input.size() && (data[m_pos] == ' ' || data[m_pos] == '\t')) {
+        ++m_pos;
+    }
+    if (m_pos >= m_input.size()) {
+        m_reachedEnd = true;
+    }
+}
+
+void LaTeXTokenizer::skipWhitespace() {
+    const char16_t *data = m_input.utf16();
+    qsizetype end = m_pos;
+    while (end < m_input.size()
+           && (data[end] == ' ' || data[end] == '\t' || data[end] == '\r' || data[end] == '\n')) {
+        ++end;
+    }
+    if (end >= m_input.size()) {
+        m_reachedEnd = true;
+    }
+    advanceTo(end);
+}
+
+bool LaTeXTokenizer::skipChar(QChar ch) {
+    if (m_pos >= m_input.size()) {
+        m_reachedEnd = true;
+        return false;
+    }
+    if (m_input[m_pos] == ch) {
+        advanceTo(m_pos + 1);
+        return true;
+    }
+    return false;
+}
+
+bool LaTeXTokenizer::beginGroup(bool allowStar) {
+    const Mark start = mark();
+    if (allowStar) {
+        skipChar(QLatin1Char('*'));
+    }
+    skipSpaces();
+    if (skipChar(QLatin1Char('{'))) {
+        return true;
+    }
+    reset(start);
+    return false;
+}
+
+bool LaTeXTokenizer::readGroup(QStringView &content) {
+    const Mark start = mark();
+    skipSpaces();
+
+    const qsizetype size = m_input.size();
+    const char16_t *data = m_input.utf16();
+    if (m_pos >= size || data[m_pos] != '{') {
+        reset(start);
+        return false;
+    }
+
+    int depth = 1;
+    qsizetype i = m_pos + 1;
+    for (; i < size; ++i) {
+        const char16_t ch = data[i];
+        if (ch == '\\') {
+            ++i;
+        } else if (ch == '{') {
+            ++depth;
+        } else if (ch == '}' && --depth == 0) {
+            break;
+        }
+    }
+
+    if (i >= size) {
+        m_reachedEnd = true;
+        reset(start);
+        return false;
+    }
+
+    content = m_input.mid(m_pos + 1, i - m_pos - 1);
+    advanceTo(i + 1);
+    return true;
+}
+
+bool LaTeXTokenizer::readOptional(QStringView &content) {
+    const Mark start = mark();
+    skipSpaces();
+
+    const qsizetype size = m_input.size();
+    const char16_t *data = m_input.utf16();
+    if (m_pos >= size || data[m_pos] != '[') {
+        reset(start);
+        return false;
+    }
+
+    int braceDepth = 0;
+    qsizetype i = m_pos + 1;
+    for (; i < size; ++i) {
+        const char16_t ch = data[i];
+        if (ch == '\\') {
+            ++i;
+        } else if (ch == '{') {
+            ++braceDepth;
+        } else if (ch == '}') {
+            --braceDepth;
+        } else if (ch == ']' && braceDepth <= 0) {
+            break;
+        }
+    }
+
+    if (i >= size) {
+        m_reachedEnd = true;
+        reset(start);
+        return false;
+    }
+
+    content = m_input.mid(m_pos + 1, i - m_pos - 1);
+    advanceTo(i + 1);
+    return true;
+}
+
+bool LaTeXTokenizer::readDelimited(QStringView &content) {
+    const qsizetype size = m_input.size();
+    const char16_t *data = m_input.utf16();
+    if (m_pos >= size) {
+        m_reachedEnd = true;
+        return false;
+    }
+
+    const char16_t delimiter = data[m_pos];
+    if (isAsciiLetter(delimiter) || delimiter == ' ' || delimiter == '\t' || delimiter == '\n') {
+        return false;
+    }
+
+    qsizetype i = m_pos + 1;
+    while (i < size && data[i] != delimiter && data[i] != '\n') {
+        ++i;
+    }
+    if (i >= size) {
+        m_reachedEnd = true;
+        return false;
+    }
+    if (data[i] != delimiter) {
+        return false;
+    }
+
+    content = m_input.mid(m_pos + 1, i - m_pos - 1);
+    advanceTo(i + 1);
+    return true;
+}
+
+bool LaTeXTokenizer::readUntil(QStringView terminator, QStringView &content) {
+    const char16_t *data = m_input.utf16();
+    qsizetype from = m_pos;
+
+    while (true) {
+        const qsizetype index = m_input.indexOf(terminator, from);
+        if (index < 0) {
+            m_reachedEnd = true;
+            content = m_input.mid(m_pos);
+            advanceTo(m_input.size());
+            return false;
+        }
+
+        // An odd number of backslashes in front escapes the terminator
+        qsizetype backslashes = 0;
+        while (index - backslashes - 1 >= m_pos && data[index - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 0) {
+            content = m_input.mid(m_pos, index - m_pos);
+            advanceTo(index + terminator.size());
+            return true;
+        }
+        from = index + 1;
+    }
+}
@@ -0,0 +1,82 @@
+// LaTeXTokenizer.h
+#ifndef LATEXTOKENIZER_H
+#define LATEXTOKENIZER_H
+
+#include <QString>
+#include <QStringView>
+
+struct LaTeXToken {
+    enum Type {
+        Text,             // Run of ordinary characters
+        Command,          // \name or control symbol, text holds the name without the backslash
+        BeginGroup,       // {
+        EndGroup,         // }
+        BeginOptional,    // [
+        EndOptional,      // ]
+        MathShift,        // $
+        DisplayMathShift, // $$
+        Alignment,        // &
+        Comment,          // % up to (not including) the end of the line, text holds the comment body
+        Newline,          // \n
+        End
+    };
+
+    Type type = End;
+    QStringView text;
+    qsizetype position = 0;
+    int line = 0;
+    int column = 0;
+};
+
+// Splits LaTeX source into tokens in a single forward pass. Arguments whose
+// content must not be tokenized (URLs, labels, verbatim text, math) can be
+// consumed raw with the read* methods.
+class LaTeXTokenizer {
+public:
+    explicit LaTeXTokenizer(QStringView input, int firstLine = 0);
+
+    LaTeXToken next();
+    bool atEnd() const { return m_pos >= m_input.size(); }
+    qsizetype position() const { return m_pos; }
+    int line() const { return m_line; }
+
+    // Saved position, used to backtrack when an optional construct is absent
+    struct Mark {
+        qsizetype pos;
+        int line;
+        qsizetype lineStart;
+    };
+    Mark mark() const { return {m_pos, m_line, m_lineStart}; }
+    void reset(const Mark &mark);
+
+    // Raw readers. Leading spaces and tabs are skipped. On failure the
+    // position is left unchanged.
+    bool readGroup(QStringView &content);
+    bool readOptional(QStringView &content);
+    bool readDelimited(QStringView &content);
+    bool beginGroup(bool allowStar = false);
+    bool skipChar(QChar ch);
+    void skipWhitespace();
+
+    // Consumes everything up to the next unescaped terminator and the terminator itself.
+    // Returns false (consuming the rest of the input) if the terminator is missing.
+    bool readUntil(QStringView terminator, QStringView &content);
+
+    // Set once a token or raw reader looked for something up to the end of
+    // the input without finding it. More input after the end could then have
+    // changed the tokens, so a block tokenized on its own may differ from the
+    // same text tokenized as part of the document.
+    bool reachedEnd() const { return m_reachedEnd; }
+
+private:
+    void skipSpaces();
+    void advanceTo(qsizetype pos);
+
+    QStringView m_input;
+    qsizetype m_pos;
+    int m_line;
+    qsizetype m_lineStart;
+    bool m_reachedEnd;
+};
+
+#endif // LATEXTOKENIZER_H
@@ -0,0 +1,82 @@
+// MathJaxLocator.cpp
+#include "MathJaxLocator.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QDebug>
+
+namespace {
+
+const char *const ScriptName = "tex-mml-chtml.js";
+const char *const CdnScriptUrl = "https://cdn.jsdelivr.net/npm/mathjax@3/es5/tex-mml-chtml.js";
+
+} // namespace
+
+MathJaxLocation MathJaxLocator::locate(bool allowCdn) {
+    const MathJaxLocation &local = localLocation();
+    if (!local.scriptUrl.isEmpty() || !allowCdn) {
+        return local;
+    }
+
+    MathJaxLocation cdn;
+    cdn.scriptUrl = QUrl(QLatin1String(CdnScriptUrl));
+    return cdn;
+}
+
+const MathJaxLocation &MathJaxLocator::localLocation() {
+    static const MathJaxLocation location = []() {
+        MathJaxLocation result;
+
+        const QString localScript = findLocalScript();
+        if (!localScript.isEmpty()) {
+            result.scriptUrl = QUrl::fromLocalFile(localScript);
+            result.baseUrl = QUrl::fromLocalFile(QFileInfo(localScript).absolutePath() + QLatin1Char('/'));
+            qDebug() << "Using local MathJax:" << localScript;
+            return result;
+        }
+
+        // Only the editor links the bundled copy; files written by the
+        // command-line tools cannot use qrc: URLs anyway
+        if (QFile::exists(QLatin1String(":/mathjax/") + QLatin1String(ScriptName))) {
+            result.scriptUrl = QUrl(QLatin1String("qrc:/mathjax/") + QLatin1String(ScriptName));
+            result.baseUrl = QUrl(QLatin1String("qrc:/mathjax/"));
+            qDebug() << "Using bundled MathJax";
+        }
+        return result;
+    }();
+    return location;
+}
+
+QString MathJaxLocator::findLocalScript() {
+    QString path = qEnvironmentVariable("LATEXEDITOR_MATHJAX");
+    if (path.isEmpty()) {
+        QSettings settings;
+        path = settings.value("preview/mathJaxPath").toString();
+    }
+    if (path.isEmpty()) {
+        return QString();
+    }
+
+    const QFileInfo info(path);
+    if (info.isFile()) {
+        return info.absoluteFilePath();
+    }
+
+    // Accept the MathJax package directory as well as its es5 directory
+    if (info.isDir()) {
+        const QDir dir(info.absoluteFilePath());
+        const QString candidates[] = {
+            dir.filePath(QLatin1String(ScriptName)),
+            dir.filePath(QLatin1String("es5/") + QLatin1String(ScriptName))
+        };
+        for (const QString &candidate : candidates) {
+            if (QFileInfo::exists(candidate)) {
+                return candidate;
+            }
+        }
+    }
+
+    qWarning() << "MathJax not found at" << path;
+    return QString();
+}
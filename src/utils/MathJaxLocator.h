@@ -0,0 +1,29 @@
+// MathJaxLocator.h
+#ifndef MATHJAXLOCATOR_H
+#define MATHJAXLOCATOR_H
+
+#include <QString>
+#include <QUrl>
+
+// Where the preview page loads MathJax from
+struct MathJaxLocation {
+    QUrl scriptUrl;     // Empty if MathJax is not available
+    QUrl baseUrl;       // Base URL the preview page must be loaded with
+};
+
+// Finds MathJax without touching the network when possible. The first match wins:
+//   1. LATEXEDITOR_MATHJAX environment variable or the "preview/mathJaxPath"
+//      setting: tex-mml-chtml.js itself or a MathJax directory containing it
+//   2. The copy bundled into the resources (built with -DMATHJAX_DIR=...)
+//   3. The public CDN, if allowed
+// Local lookups are done once per process.
+class MathJaxLocator {
+public:
+    static MathJaxLocation locate(bool allowCdn);
+
+private:
+    static QString findLocalScript();
+    static const MathJaxLocation &localLocation();
+};
+
+#endif // MATHJAXLOCATOR_H
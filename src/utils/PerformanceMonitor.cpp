@@ -0,0 +1,75 @@
+// PerformanceMonitor.cpp
+#include "PerformanceMonitor.h"
+#include <QMutexLocker>
+
+PerformanceMonitor& PerformanceMonitor::getInstance() {
+    static PerformanceMonitor instance;
+    return instance;
+}
+
+// Off until enabled from the performance panel, so instrumented code pays
+// only for one relaxed load
+PerformanceMonitor::PerformanceMonitor() : m_enabled(false) {
+}
+
+void PerformanceMonitor::record(const QString &stage, qint64 nanoseconds) {
+    QMutexLocker locker(&m_mutex);
+    Samples &samples = m_stages[stage];
+
+    // Ring buffer of the most recent samples for the rolling average
+    samples.windowSum += nanoseconds - samples.window[samples.next];
+    samples.window[samples.next] = nanoseconds;
+    samples.next = (samples.next + 1) % WindowSize;
+    samples.last = nanoseconds;
+    ++samples.count;
+}
+
+QVector<StageTiming> PerformanceMonitor::snapshot() const {
+    QMutexLocker locker(&m_mutex);
+
+    QVector<StageTiming> timings;
+    timings.reserve(m_stages.size());
+    for (auto it = m_stages.constBegin(); it != m_stages.constEnd(); ++it) {
+        const Samples &samples = it.value();
+        const quint64 windowCount = qMin<quint64>(samples.count, WindowSize);
+
+        StageTiming timing;
+        timing.name = it.key();
+        timing.lastMs = samples.last / 1e6;
+        timing.averageMs = windowCount > 0 ? samples.windowSum / 1e6 / windowCount : 0.0;
+        timing.samples = samples.count;
+        timings.append(timing);
+    }
+    return timings;
+}
+
+void PerformanceMonitor::reset() {
+    QMutexLocker locker(&m_mutex);
+    m_stages.clear();
+}
+
+void PerformanceMonitor::setEnabled(bool enabled) {
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+PassTimer::PassTimer(const char *stage)
+    : m_stage(stage)
+    , m_nanoseconds(0)
+    , m_pending(false)
+{
+}
+
+void PassTimer::add(qint64 nanoseconds) {
+    m_nanoseconds += nanoseconds;
+    if (m_pending) {
+        return;
+    }
+
+    // Runs once the current event, such as one edit, has been handled
+    m_pending = true;
+    QMetaObject::invokeMethod(&m_context, [this]() {
+        PerformanceMonitor::getInstance().record(QLatin1String(m_stage), m_nanoseconds);
+        m_nanoseconds = 0;
+        m_pending = false;
+    }, Qt::QueuedConnection);
+}
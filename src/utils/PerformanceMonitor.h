@@ -0,0 +1,119 @@
+// PerformanceMonitor.h
+#ifndef PERFORMANCEMONITOR_H
+#define PERFORMANCEMONITOR_H
+
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QObject>
+#include <atomic>
+
+// Timing of one instrumented stage
+struct StageTiming {
+    QString name;
+    double lastMs = 0.0;
+    double averageMs = 0.0;     // Over the last PerformanceMonitor::WindowSize samples
+    quint64 samples = 0;
+};
+
+// Collects stage timings from any thread. Stages are named "Group: stage"
+// so related ones sort together. Recording is off by default; every sample
+// takes a lock, so stages are timed per pass or per document, not per line.
+class PerformanceMonitor {
+public:
+    static constexpr int WindowSize = 32;
+
+    static PerformanceMonitor& getInstance();
+
+    void record(const QString &stage, qint64 nanoseconds);
+    QVector<StageTiming> snapshot() const;
+    void reset();
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+private:
+    PerformanceMonitor();
+    PerformanceMonitor(const PerformanceMonitor &) = delete;
+    PerformanceMonitor &operator=(const PerformanceMonitor &) = delete;
+
+    struct Samples {
+        qint64 last = 0;
+        qint64 window[WindowSize] = {};
+        qint64 windowSum = 0;
+        int next = 0;
+        quint64 count = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QMap<QString, Samples> m_stages;
+    std::atomic<bool> m_enabled;
+};
+
+// Adds up the time of work that runs in many small pieces, such as
+// highlighting one line at a time, and records one sample under 'stage' for
+// all pieces that ran before control returned to the event loop. Use from
+// the thread that owns it.
+class PassTimer {
+public:
+    explicit PassTimer(const char *stage);
+
+    void add(qint64 nanoseconds);
+
+    PassTimer(const PassTimer &) = delete;
+    PassTimer &operator=(const PassTimer &) = delete;
+
+private:
+    const char *m_stage;
+    qint64 m_nanoseconds;
+    bool m_pending;
+    QObject m_context;   // Drops the queued recording if the timer goes away first
+};
+
+// Records the time until the end of the scope under 'stage', or adds it to 'pass'
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char *stage)
+        : m_stage(stage)
+        , m_pass(nullptr)
+        , m_active(PerformanceMonitor::getInstance().isEnabled())
+    {
+        if (m_active) {
+            m_timer.start();
+        }
+    }
+
+    explicit ScopedTimer(PassTimer &pass)
+        : m_stage(nullptr)
+        , m_pass(&pass)
+        , m_active(PerformanceMonitor::getInstance().isEnabled())
+    {
+        if (m_active) {
+            m_timer.start();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (!m_active) {
+            return;
+        }
+        if (m_pass) {
+            m_pass->add(m_timer.nsecsElapsed());
+        } else {
+            PerformanceMonitor::getInstance().record(QLatin1String(m_stage), m_timer.nsecsElapsed());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    const char *m_stage;
+    PassTimer *m_pass;
+    bool m_active;
+    QElapsedTimer m_timer;
+};
+
+#endif // PERFORMANCEMONITOR_H
@@ -0,0 +1,56 @@
+// PreviewRenderer.cpp
+#include "PreviewRenderer.h"
+#include "PerformanceMonitor.h"
+#include <QThread>
+#include <QDebug>
+
+PreviewRenderer::PreviewRenderer(QObject *parent)
+    : QObject(parent)
+    , m_latestGeneration(0)
+    , m_blockCache(m_converter)
+{
+    // Use the enhanced converter (with CDN for MathJax)
+    m_documentShell = m_converter.generatePreviewShell(true);
+}
+
+void PreviewRenderer::setLatestGeneration(quint64 generation) {
+    m_latestGeneration.store(generation);
+}
+
+bool PreviewRenderer::isStale(quint64 generation) const {
+    return generation != m_latestGeneration.load()
+        || QThread::currentThread()->isInterruptionRequested();
+}
+
+void PreviewRenderer::render(quint64 generation, const QString &latexContent) {
+    // Requests queue up while a conversion runs; skip the ones already superseded
+    if (isStale(generation)) {
+        return;
+    }
+
+    ScopedTimer timer("Preview: total");
+    QVector<HtmlBlock> blocks;
+    const bool completed = m_blockCache.convertBlocks(latexContent, blocks, [this, generation]() {
+        return isStale(generation);
+    });
+    if (!completed) {
+        qDebug() << "Preview generation" << generation << "cancelled";
+        return;
+    }
+
+    qDebug() << "Preview blocks converted:" << m_blockCache.lastConvertedCount()
+             << "reused:" << m_blockCache.lastReusedCount();
+
+    QStringList blockKeys;
+    QStringList blockHtml;
+    blockKeys.reserve(blocks.size());
+    blockHtml.reserve(blocks.size());
+    for (const HtmlBlock &block : blocks) {
+        // The page reuses blocks with the same key, so the key also covers
+        // the HTML in case two sources share a hash
+        blockKeys.append(QString::number(block.key, 16) + QLatin1Char('-') + QString::number(qHash(block.html), 16));
+        blockHtml.append(block.html);
+    }
+
+    emit renderFinished(generation, m_documentShell, blockKeys, blockHtml);
+}
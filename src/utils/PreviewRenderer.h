@@ -0,0 +1,42 @@
+// PreviewRenderer.h
+#ifndef PREVIEWRENDERER_H
+#define PREVIEWRENDERER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include "LaTeXToHtmlConverter.h"
+#include "LaTeXBlockCache.h"
+
+// Converts preview snapshots on a worker thread. Every snapshot carries a
+// generation number; a job is abandoned as soon as a newer generation has
+// been requested, so only the newest result is ever delivered.
+class PreviewRenderer : public QObject {
+Q_OBJECT
+
+public:
+    explicit PreviewRenderer(QObject *parent = nullptr);
+
+    // Thread-safe: marks every job older than 'generation' as stale
+    void setLatestGeneration(quint64 generation);
+
+public slots:
+    void render(quint64 generation, const QString &latexContent);
+
+signals:
+    // The page shell stays the same between results; blocks are listed in
+    // document order, each with a key identifying its source text.
+    void renderFinished(quint64 generation, const QString &documentShell,
+                        const QStringList &blockKeys, const QStringList &blockHtml);
+
+private:
+    bool isStale(quint64 generation) const;
+
+    std::atomic<quint64> m_latestGeneration;
+    LaTeXToHtmlConverter m_converter;
+    LaTeXBlockCache m_blockCache;
+    QString m_documentShell;
+};
+
+#endif // PREVIEWRENDERER_H
@@ -7,6 +7,7 @@ SpellCheckHighlighter::SpellCheckHighlighter(SpellChecker *spellChecker, QTextDo
     : QSyntaxHighlighter(parent)
     , m_spellChecker(spellChecker)
     , m_enabled(false)
+    , m_passTimer("Highlighting: spelling pass")
 {
     // Format for misspelled words: red wavy underline
     m_misspelledFormat.setUnderlineColor(Qt::red);
@@ -30,11 +31,17 @@ bool SpellCheckHighlighter::isEnabled() const {
     return m_enabled;
 }
 
+void SpellCheckHighlighter::rehighlight() {
+    QSyntaxHighlighter::rehighlight();
+}
+
 void SpellCheckHighlighter::highlightBlock(const QString &text) {
     if (!m_enabled || !m_spellChecker || !m_spellChecker->isInitialized()) {
         return;
     }
 
+    ScopedTimer timer(m_passTimer);
+
     // Extract words from the text
     QList<WordPosition> words = extractWords(text);
 
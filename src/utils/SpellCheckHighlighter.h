@@ -6,6 +6,7 @@
 #include <QTextCharFormat>
 #include <QRegularExpression>
 #include "SpellChecker.h"
+#include "PerformanceMonitor.h"
 
 class SpellCheckHighlighter : public QSyntaxHighlighter {
 Q_OBJECT
@@ -25,6 +26,7 @@ private:
     SpellChecker *m_spellChecker;
     bool m_enabled;
     QTextCharFormat m_misspelledFormat;
+    PassTimer m_passTimer;
 
     // Extract words from text, skipping LaTeX commands
     struct WordPosition {
@@ -9,6 +9,8 @@
 #include <QMessageBox>
 #include <QPrinter>
 #include <QPrintDialog>
+#include <QSettings>
+#include <QtConcurrent>
 #include "../controllers/FileController.h"
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), m_highlighter(nullptr) {
@@ -95,11 +97,28 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), m_highlighter(nul
     // Set spell checker in editor for context menu
     m_editor->setSpellChecker(m_spellChecker);
 
-    // Initialize error checker
-    m_errorChecker = new LaTeXErrorChecker(this);
+    // Initialize error checker; checks run on a worker thread so typing never waits for them
+    m_errorCheckVersion = 0;
+    m_errorCheckWorker = new ErrorCheckWorker();
+    m_errorCheckWorker->setDisabledRules(QSettings().value("checker/disabledRules").toStringList());
+    m_errorCheckWorker->moveToThread(&m_errorCheckThread);
+    connect(&m_errorCheckThread, &QThread::finished, m_errorCheckWorker, &QObject::deleteLater);
+    connect(this, &MainWindow::errorCheckRequested, m_errorCheckWorker, &ErrorCheckWorker::check,
+            Qt::QueuedConnection);
+    connect(this, &MainWindow::checkerRulesChanged, m_errorCheckWorker, &ErrorCheckWorker::setDisabledRules,
+            Qt::QueuedConnection);
+    connect(m_errorCheckWorker, &ErrorCheckWorker::checkProgress, this, &MainWindow::onErrorCheckProgress,
+            Qt::QueuedConnection);
+    connect(m_errorCheckWorker, &ErrorCheckWorker::checkFinished, this, &MainWindow::onErrorCheckFinished,
+            Qt::QueuedConnection);
+    m_errorCheckThread.start();
+
+    connect(&m_projectLintWatcher, &QFutureWatcher<LaTeXProjectLinter::Result>::finished,
+            this, &MainWindow::onProjectLintFinished);
+
     m_errorCheckTimer = new QTimer(this);
     m_errorCheckTimer->setSingleShot(true);
-    m_errorCheckTimer->setInterval(1000); // 1 second delay
+    m_errorCheckTimer->setInterval(300); // Short delay, checking is incremental and off the GUI thread
     connect(m_errorCheckTimer, &QTimer::timeout, this, &MainWindow::checkForErrors);
     connect(m_editor, &CodeEditor::textChanged, m_errorCheckTimer, qOverload<>(&QTimer::start));
 
@@ -136,6 +155,16 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), m_highlighter(nul
         }
     }
 
+    // Stage timings: dock panel (hidden until requested) and a status bar summary
+    m_performancePanel = new PerformancePanel(this);
+    addDockWidget(Qt::BottomDockWidgetArea, m_performancePanel);
+    m_performancePanel->hide();
+    m_performanceLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_performanceLabel);
+    connect(m_performancePanel, &PerformancePanel::summaryChanged, m_performanceLabel, &QLabel::setText);
+    connect(m_performancePanel, &PerformancePanel::ruleProfilingToggled,
+            m_errorCheckWorker, &ErrorCheckWorker::setRuleProfilingEnabled, Qt::QueuedConnection);
+
     createActions();
     createMenus();
 
@@ -193,6 +222,11 @@ MainWindow::~MainWindow() {
         m_spellChecker->savePersonalDictionary(SpellChecker::getDefaultPersonalDictionaryPath());
     }
 
+    m_errorCheckThread.requestInterruption();
+    m_errorCheckThread.quit();
+    m_errorCheckThread.wait();
+    m_projectLintWatcher.waitForFinished();
+
     // Qt's parent-child ownership handles cleanup automatically
     // All objects created with 'this' as parent are deleted when MainWindow is destroyed
 }
@@ -275,6 +309,11 @@ void MainWindow::createActions() {
     setAsMainFileAct->setStatusTip(tr("Set the current file as the main project file"));
     connect(setAsMainFileAct, &QAction::triggered, this, &MainWindow::setAsMainFile);
 
+    lintProjectAct = new QAction(tr("&Lint Project"), this);
+    lintProjectAct->setShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_L));
+    lintProjectAct->setStatusTip(tr("Check the saved main file and every file it includes"));
+    connect(lintProjectAct, &QAction::triggered, this, &MainWindow::lintProject);
+
     themeActGroup = new QActionGroup(this);
     try {
         for (const QString &themeName : ThemeManager::getInstance().getThemeNames()) {
@@ -375,6 +414,18 @@ void MainWindow::createMenus() {
     editMenu->addSeparator();
     editMenu->addAction(spellCheckAct);
 
+    // One checkable entry per error check rule, saved across sessions
+    checkerRulesMenu = editMenu->addMenu(tr("Error Check Rules"));
+    const QStringList disabledRules = QSettings().value("checker/disabledRules").toStringList();
+    for (int rule = 0; rule < LaTeXErrorChecker::RuleCount; ++rule) {
+        const QString name = LaTeXErrorChecker::ruleName(static_cast<LaTeXErrorChecker::Rule>(rule));
+        QAction *action = checkerRulesMenu->addAction(name);
+        action->setData(name);
+        action->setCheckable(true);
+        action->setChecked(!disabledRules.contains(name));
+        connect(action, &QAction::toggled, this, &MainWindow::updateCheckerRules);
+    }
+
     viewMenu = menuBar()->addMenu(tr("&View"));
     viewMenu->addAction(toggleProjectTreeAct);
     viewMenu->addSeparator();
@@ -384,10 +435,12 @@ void MainWindow::createMenus() {
     viewMenu->addSeparator();
     viewMenu->addAction(rebuildPreviewAct);
     viewMenu->addAction(showErrorsAct);
+    viewMenu->addAction(m_performancePanel->toggleViewAction());
 
     // Add Project menu
     QMenu *projectMenu = menuBar()->addMenu(tr("&Project"));
     projectMenu->addAction(setAsMainFileAct);
+    projectMenu->addAction(lintProjectAct);
 }
 
 void MainWindow::rebuildPreview() {
@@ -601,8 +654,25 @@ void MainWindow::newFromTemplate() {
 }
 
 void MainWindow::checkForErrors() {
-    QString content = m_editor->toPlainText();
-    QVector<LaTeXError> errors = m_errorChecker->checkDocument(content);
+    // The worker checks an immutable snapshot; older snapshots still queued are dropped
+    ++m_errorCheckVersion;
+    m_errorCheckWorker->setLatestVersion(m_errorCheckVersion);
+    emit errorCheckRequested(m_errorCheckVersion, m_editor->toPlainText(), m_editor->lastVisibleLine());
+}
+
+void MainWindow::onErrorCheckProgress(quint64 version, const QVector<LaTeXError> &errors) {
+    if (version != m_errorCheckVersion) {
+        return;
+    }
+    // Lines past the checked ones have no errors yet; the final result follows
+    m_editor->setErrors(errors);
+}
+
+void MainWindow::onErrorCheckFinished(quint64 version, const QVector<LaTeXError> &errors) {
+    // The text changed after this snapshot was taken; a newer result follows
+    if (version != m_errorCheckVersion) {
+        return;
+    }
     m_editor->setErrors(errors);
 
     // Update status bar
@@ -613,8 +683,20 @@ void MainWindow::checkForErrors() {
     }
 }
 
+void MainWindow::updateCheckerRules() {
+    QStringList disabledRules;
+    for (QAction *action : checkerRulesMenu->actions()) {
+        if (!action->isChecked()) {
+            disabledRules.append(action->data().toString());
+        }
+    }
+    QSettings().setValue("checker/disabledRules", disabledRules);
+    emit checkerRulesChanged(disabledRules);
+    checkForErrors();
+}
+
 void MainWindow::showErrorPanel() {
-    QVector<LaTeXError> errors = m_editor->getErrors();
+    const QVector<LaTeXError> &errors = m_editor->getErrors();
 
     if (errors.isEmpty()) {
         QMessageBox::information(this, tr("LaTeX Errors"),
@@ -625,54 +707,11 @@ void MainWindow::showErrorPanel() {
     QString errorText = tr("Found %1 error(s):\n\n").arg(errors.size());
 
     for (const LaTeXError &error : errors) {
-        QString errorType;
-        switch (error.type) {
-            case LaTeXError::UnmatchedBrace:
-                errorType = "Unmatched Brace";
-                break;
-            case LaTeXError::UnmatchedBracket:
-                errorType = "Unmatched Bracket";
-                break;
-            case LaTeXError::UnmatchedEnvironment:
-                errorType = "Unmatched Environment";
-                break;
-            case LaTeXError::UnmatchedMathDelimiter:
-                errorType = "Unmatched Math Delimiter";
-                break;
-            case LaTeXError::InvalidCommand:
-                errorType = "Invalid Command";
-                break;
-            case LaTeXError::MissingArgument:
-                errorType = "Missing Argument";
-                break;
-            case LaTeXError::UnknownCommand:
-                errorType = "Unknown Command";
-                break;
-            case LaTeXError::MissingPackage:
-                errorType = "Missing Package";
-                break;
-            case LaTeXError::UsePackageAfterBeginDocument:
-                errorType = "Package After \\begin{document}";
-                break;
-            case LaTeXError::InvalidArgumentCount:
-                errorType = "Invalid Argument Count";
-                break;
-            case LaTeXError::DeprecatedCommand:
-                errorType = "Deprecated Command";
-                break;
-            case LaTeXError::MathModeRequired:
-                errorType = "Math Mode Required";
-                break;
-            case LaTeXError::TextModeRequired:
-                errorType = "Text Mode Required";
-                break;
-        }
-
         errorText += QString("Line %1, Col %2: [%3] %4\n")
                          .arg(error.line + 1)
                          .arg(error.column + 1)
-                         .arg(errorType)
-                         .arg(error.message);
+                         .arg(errorTypeName(error.type))
+                         .arg(error.message());
     }
 
     QMessageBox msgBox(this);
@@ -682,6 +721,38 @@ void MainWindow::showErrorPanel() {
     msgBox.exec();
 }
 
+QString MainWindow::errorTypeName(LaTeXError::ErrorType type) {
+    switch (type) {
+        case LaTeXError::UnmatchedBrace:
+            return "Unmatched Brace";
+        case LaTeXError::UnmatchedBracket:
+            return "Unmatched Bracket";
+        case LaTeXError::UnmatchedEnvironment:
+            return "Unmatched Environment";
+        case LaTeXError::UnmatchedMathDelimiter:
+            return "Unmatched Math Delimiter";
+        case LaTeXError::InvalidCommand:
+            return "Invalid Command";
+        case LaTeXError::MissingArgument:
+            return "Missing Argument";
+        case LaTeXError::UnknownCommand:
+            return "Unknown Command";
+        case LaTeXError::MissingPackage:
+            return "Missing Package";
+        case LaTeXError::UsePackageAfterBeginDocument:
+            return "Package After \\begin{document}";
+        case LaTeXError::InvalidArgumentCount:
+            return "Invalid Argument Count";
+        case LaTeXError::DeprecatedCommand:
+            return "Deprecated Command";
+        case LaTeXError::MathModeRequired:
+            return "Math Mode Required";
+        case LaTeXError::TextModeRequired:
+            return "Text Mode Required";
+    }
+    return QString();
+}
+
 QString MainWindow::getTemplate(const QString &templateName) {
     if (templateName == "article") {
         return R"(\documentclass[12pt]{article}
@@ -838,3 +909,58 @@ void MainWindow::setAsMainFile() {
     m_projectModel->setMainFile(currentFile);
     statusBar()->showMessage(tr("Set %1 as main project file").arg(QFileInfo(currentFile).fileName()), 3000);
 }
+
+void MainWindow::lintProject() {
+    if (!m_projectModel->hasProject()) {
+        QMessageBox::information(this, tr("No Project"),
+                               tr("Please set a main file first to lint the whole project."));
+        return;
+    }
+    if (m_projectLintWatcher.isRunning()) {
+        return;
+    }
+
+    // Includes are resolved here, on the model's thread; the files are read from disk
+    m_projectModel->scanProjectFiles();
+    const QString mainFile = m_projectModel->getMainFile();
+    const LaTeXProjectLinter::IncludeMap includes = LaTeXProjectLinter::includeMap(*m_projectModel);
+
+    lintProjectAct->setEnabled(false);
+    statusBar()->showMessage(tr("Linting project..."));
+    m_projectLintWatcher.setFuture(QtConcurrent::run([this, mainFile, includes]() {
+        return m_projectLinter.lint(mainFile, includes);
+    }));
+}
+
+void MainWindow::onProjectLintFinished() {
+    lintProjectAct->setEnabled(true);
+    const LaTeXProjectLinter::Result result = m_projectLintWatcher.result();
+    statusBar()->showMessage(tr("Linted %1 file(s), %2 checked, %3 from cache")
+                                 .arg(result.files.size())
+                                 .arg(result.checkedFiles)
+                                 .arg(result.files.size() - result.checkedFiles), 5000);
+
+    if (result.errors.isEmpty()) {
+        QMessageBox::information(this, tr("Project Lint"),
+                               tr("No syntax errors found in %1 project file(s).").arg(result.files.size()));
+        return;
+    }
+
+    const QDir projectDir(m_projectModel->getProjectDirectory());
+    QString errorText;
+    for (const LaTeXError &error : result.errors) {
+        errorText += QString("%1:%2:%3: [%4] %5\n")
+                         .arg(projectDir.relativeFilePath(error.file))
+                         .arg(error.line + 1)
+                         .arg(error.column + 1)
+                         .arg(errorTypeName(error.type))
+                         .arg(error.message());
+    }
+
+    QMessageBox msgBox(this);
+    msgBox.setWindowTitle(tr("Project Lint"));
+    msgBox.setText(tr("Found %1 error(s) in %2 project file(s).").arg(result.errors.size()).arg(result.files.size()));
+    msgBox.setDetailedText(errorText);
+    msgBox.setIcon(QMessageBox::Warning);
+    msgBox.exec();
+}
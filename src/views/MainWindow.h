@@ -10,18 +10,24 @@
 #include "../utils/ThemeManager.h"
 #include "../utils/CodeEditor.h"
 #include "../utils/LaTeXErrorChecker.h"
+#include "../utils/ErrorCheckWorker.h"
+#include "../utils/LaTeXProjectLinter.h"
 #include "../utils/SpellChecker.h"
 #include "../utils/SpellCheckHighlighter.h"
 #include "LatexToolbar.h"
 #include "../controllers/LatexToolbarController.h"
 #include "PreviewWindow.h"
 #include "ProjectTreeWidget.h"
+#include "PerformancePanel.h"
 #include "../controllers/PreviewController.h"
 #include "../controllers/AutoSaveController.h"
 #include "../models/ProjectModel.h"
 #include <QSettings>
 #include <QTimer>
+#include <QThread>
+#include <QFutureWatcher>
 #include <QSplitter>
+#include <QLabel>
 
 class DocumentModel;
 class FileController;
@@ -43,6 +49,8 @@ public slots:
 
 signals:
     void themeChangeRequested(const QString &themeName);
+    void errorCheckRequested(quint64 version, const QString &content, int lastVisibleLine);
+    void checkerRulesChanged(const QStringList &disabledRules);
 
 private slots:
     void changeTheme();
@@ -55,17 +63,23 @@ private slots:
     void toggleSpellCheck(bool enabled);
     void newFromTemplate();
     void checkForErrors();
+    void onErrorCheckProgress(quint64 version, const QVector<LaTeXError> &errors);
+    void onErrorCheckFinished(quint64 version, const QVector<LaTeXError> &errors);
     void showErrorPanel();
+    void updateCheckerRules();
     void onProjectFileSelected(const QString &filePath);
     void onProjectFileDoubleClicked(const QString &filePath);
     void toggleProjectTree();
     void setAsMainFile();
+    void lintProject();
+    void onProjectLintFinished();
 
 private:
     void createActions();
     void createMenus();
     void updateRecentFileActions();
     QString getTemplate(const QString &templateName);
+    static QString errorTypeName(LaTeXError::ErrorType type);
 
     CodeEditor *m_editor;
     LaTeXHighlighter *m_highlighter;
@@ -80,15 +94,26 @@ private:
     ProjectTreeWidget *m_projectTreeWidget;
     SpellChecker *m_spellChecker;
     SpellCheckHighlighter *m_spellCheckHighlighter;
-    LaTeXErrorChecker *m_errorChecker;
     QTimer *m_errorCheckTimer;
+
+    // Checking runs on m_errorCheckThread; m_errorCheckWorker lives there
+    QThread m_errorCheckThread;
+    ErrorCheckWorker *m_errorCheckWorker;
+    quint64 m_errorCheckVersion;
+
+    // Project lint runs on the thread pool; the linter keeps its per-file cache between runs
+    LaTeXProjectLinter m_projectLinter;
+    QFutureWatcher<LaTeXProjectLinter::Result> m_projectLintWatcher;
     QSplitter *m_mainSplitter;
+    PerformancePanel *m_performancePanel;
+    QLabel *m_performanceLabel;
 
     QMenu *fileMenu;
     QMenu *viewMenu;
     QMenu *editMenu;
     QMenu *recentFilesMenu;
     QMenu *templatesMenu;
+    QMenu *checkerRulesMenu;
 
     QAction *newAct;
     QAction *openAct;
@@ -102,6 +127,7 @@ private:
     QAction *rebuildPreviewAct;
     QAction *toggleProjectTreeAct;
     QAction *setAsMainFileAct;
+    QAction *lintProjectAct;
 
     QActionGroup *themeActGroup;
 
@@ -0,0 +1,98 @@
+// PerformancePanel.cpp
+#include "PerformancePanel.h"
+#include "../utils/PerformanceMonitor.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+
+PerformancePanel::PerformancePanel(QWidget *parent) : QDockWidget(tr("Performance"), parent) {
+    setObjectName("PerformancePanel");
+
+    QWidget *content = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(content);
+    layout->setContentsMargins(4, 4, 4, 4);
+
+    m_table = new QTableWidget(0, 4, content);
+    m_table->setHorizontalHeaderLabels({tr("Stage"), tr("Last (ms)"), tr("Average (ms)"), tr("Samples")});
+    m_table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+    layout->addWidget(m_table);
+
+    QHBoxLayout *buttons = new QHBoxLayout();
+    m_enabledCheckBox = new QCheckBox(tr("Record timings"), content);
+    m_enabledCheckBox->setChecked(PerformanceMonitor::getInstance().isEnabled());
+    connect(m_enabledCheckBox, &QCheckBox::toggled, this, &PerformancePanel::setMonitoringEnabled);
+    buttons->addWidget(m_enabledCheckBox);
+    m_ruleProfilingCheckBox = new QCheckBox(tr("Profile checker rules"), content);
+    connect(m_ruleProfilingCheckBox, &QCheckBox::toggled, this, &PerformancePanel::ruleProfilingToggled);
+    buttons->addWidget(m_ruleProfilingCheckBox);
+    buttons->addStretch();
+
+    QPushButton *resetButton = new QPushButton(tr("Reset"), content);
+    connect(resetButton, &QPushButton::clicked, this, &PerformancePanel::resetTimings);
+    buttons->addWidget(resetButton);
+    layout->addLayout(buttons);
+
+    setWidget(content);
+
+    // Timings are recorded from several threads; polling keeps recording cheap
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setInterval(1000);
+    connect(m_refreshTimer, &QTimer::timeout, this, &PerformancePanel::refresh);
+    m_refreshTimer->start();
+}
+
+void PerformancePanel::refresh() {
+    const QVector<StageTiming> timings = PerformanceMonitor::getInstance().snapshot();
+
+    // Totals contain the other stages, so they are left out of the summary
+    const StageTiming *slowest = nullptr;
+    for (const StageTiming &timing : timings) {
+        if (timing.name.endsWith(QLatin1String(": total"))) {
+            continue;
+        }
+        if (!slowest || timing.lastMs > slowest->lastMs) {
+            slowest = &timing;
+        }
+    }
+    emit summaryChanged(slowest ? tr("Slowest: %1 %2 ms").arg(slowest->name).arg(slowest->lastMs, 0, 'f', 1)
+                                : QString());
+
+    if (!isVisible()) {
+        return;
+    }
+
+    m_table->setRowCount(timings.size());
+    for (int row = 0; row < timings.size(); ++row) {
+        const StageTiming &timing = timings[row];
+        const QString values[] = {
+            timing.name,
+            QString::number(timing.lastMs, 'f', 2),
+            QString::number(timing.averageMs, 'f', 2),
+            QString::number(timing.samples)
+        };
+        for (int column = 0; column < 4; ++column) {
+            QTableWidgetItem *item = m_table->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem();
+                if (column > 0) {
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                }
+                m_table->setItem(row, column, item);
+            }
+            item->setText(values[column]);
+        }
+    }
+}
+
+void PerformancePanel::resetTimings() {
+    PerformanceMonitor::getInstance().reset();
+    refresh();
+}
+
+void PerformancePanel::setMonitoringEnabled(bool enabled) {
+    PerformanceMonitor::getInstance().setEnabled(enabled);
+}
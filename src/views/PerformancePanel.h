@@ -0,0 +1,35 @@
+// PerformancePanel.h
+#ifndef PERFORMANCEPANEL_H
+#define PERFORMANCEPANEL_H
+
+#include <QDockWidget>
+#include <QTableWidget>
+#include <QCheckBox>
+#include <QTimer>
+
+// Dockable table of the stage timings collected by PerformanceMonitor
+class PerformancePanel : public QDockWidget {
+Q_OBJECT
+
+public:
+    explicit PerformancePanel(QWidget *parent = nullptr);
+
+signals:
+    // One-line summary for the status bar: the slowest stage of the last run
+    void summaryChanged(const QString &summary);
+    // Per-rule timings of the error checker appear as "Rules: <name>" stages
+    void ruleProfilingToggled(bool enabled);
+
+private slots:
+    void refresh();
+    void resetTimings();
+    void setMonitoringEnabled(bool enabled);
+
+private:
+    QTableWidget *m_table;
+    QCheckBox *m_enabledCheckBox;
+    QCheckBox *m_ruleProfilingCheckBox;
+    QTimer *m_refreshTimer;
+};
+
+#endif // PERFORMANCEPANEL_H
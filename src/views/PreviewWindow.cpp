@@ -1,12 +1,76 @@
 #include "PreviewWindow.h"
+#include "../utils/LaTeXToHtmlConverter.h"
+#include "../utils/MathJaxLocator.h"
+#include "../utils/PerformanceMonitor.h"
 #include <QVBoxLayout>
 
+#ifdef QT_WEBENGINEWIDGETS_LIB
+#include <QWebEnginePage>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+namespace {
+
+// Replaces removeCount blocks at 'start' with new ones and typesets only those
+const char *const PatchScript = R"(
+window.latexPreview = {
+    patch: function(start, removeCount, blocks) {
+        var container = document.getElementById('latex-preview-blocks');
+        if (!container) {
+            return;
+        }
+
+        var removed = [];
+        for (var i = 0; i < removeCount && start < container.children.length; ++i) {
+            removed.push(container.removeChild(container.children[start]));
+        }
+
+        var anchor = container.children[start] || null;
+        var added = [];
+        for (var j = 0; j < blocks.length; ++j) {
+            var node = document.createElement('div');
+            node.className = 'latex-block';
+            node.innerHTML = blocks[j];
+            container.insertBefore(node, anchor);
+            added.push(node);
+        }
+
+        if (window.MathJax && MathJax.startup && MathJax.startup.promise) {
+            MathJax.startup.promise = MathJax.startup.promise.then(function() {
+                if (MathJax.typesetClear) {
+                    MathJax.typesetClear(removed);
+                }
+                return MathJax.typesetPromise(added);
+            });
+        }
+    }
+};
+)";
+
+} // namespace
+#else
+#include <QScrollBar>
+#endif
+
 PreviewWindow::PreviewWindow(QWidget *parent) : QWidget(parent) {
     QVBoxLayout *layout = new QVBoxLayout(this);
 
 #ifdef QT_WEBENGINEWIDGETS_LIB
     m_webView = new QWebEngineView(this);
+    m_pageLoaded = false;
     layout->addWidget(m_webView);
+
+    // The patch protocol is installed into every page the view loads
+    QWebEngineScript patchScript;
+    patchScript.setName(QStringLiteral("latexPreviewPatch"));
+    patchScript.setInjectionPoint(QWebEngineScript::DocumentCreation);
+    patchScript.setWorldId(QWebEngineScript::MainWorld);
+    patchScript.setSourceCode(QString::fromUtf8(PatchScript));
+    m_webView->page()->scripts().insert(patchScript);
+
+    connect(m_webView, &QWebEngineView::loadFinished, this, &PreviewWindow::onLoadFinished);
 #else
     m_textBrowser = new QTextBrowser(this);
     layout->addWidget(m_textBrowser);
@@ -15,14 +79,79 @@ PreviewWindow::PreviewWindow(QWidget *parent) : QWidget(parent) {
     setLayout(layout);
 }
 
-void PreviewWindow::updatePreview(const QString &htmlContent) {
+void PreviewWindow::updatePreview(const QString &documentShell, const QStringList &blockKeys,
+                                  const QStringList &blockHtml) {
+    const bool shellChanged = documentShell != m_documentShell;
+    if (!shellChanged && blockKeys == m_blockKeys) {
+        return;
+    }
+
+    ScopedTimer timer("Preview: display");
+    m_documentShell = documentShell;
+    m_blockKeys = blockKeys;
+    m_blockHtml = blockHtml;
+
 #ifdef QT_WEBENGINEWIDGETS_LIB
-    m_webView->setHtml(htmlContent);
+    if (shellChanged) {
+        // Blocks are sent once the new page has finished loading
+        m_pageLoaded = false;
+        m_pageKeys.clear();
+        // The base URL lets the page load a local or bundled MathJax
+        m_webView->setHtml(m_documentShell, MathJaxLocator::locate(true).baseUrl);
+    } else if (m_pageLoaded) {
+        patchBlocks();
+    }
 #else
-    m_textBrowser->setHtml(htmlContent);
+    // QTextBrowser has no script support, so the whole document is shown again
+    QString html = m_documentShell;
+    html.replace(LaTeXToHtmlConverter::previewContainer(),
+                 LaTeXToHtmlConverter::previewContainer(m_blockHtml.join(QString())));
+
+    const int scrollPosition = m_textBrowser->verticalScrollBar()->value();
+    m_textBrowser->setHtml(html);
+    m_textBrowser->verticalScrollBar()->setValue(scrollPosition);
 #endif
 }
 
+#ifdef QT_WEBENGINEWIDGETS_LIB
+void PreviewWindow::onLoadFinished(bool ok) {
+    m_pageLoaded = ok;
+    if (ok) {
+        patchBlocks();
+    }
+}
+
+void PreviewWindow::patchBlocks() {
+    // Blocks are compared by key: only the run between the unchanged prefix
+    // and the unchanged suffix is replaced
+    const qsizetype oldCount = m_pageKeys.size();
+    const qsizetype newCount = m_blockKeys.size();
+
+    qsizetype prefix = 0;
+    while (prefix < oldCount && prefix < newCount && m_pageKeys[prefix] == m_blockKeys[prefix]) {
+        ++prefix;
+    }
+
+    qsizetype suffix = 0;
+    while (suffix < oldCount - prefix && suffix < newCount - prefix
+           && m_pageKeys[oldCount - 1 - suffix] == m_blockKeys[newCount - 1 - suffix]) {
+        ++suffix;
+    }
+
+    const qsizetype removeCount = oldCount - prefix - suffix;
+    const QStringList inserted = m_blockHtml.mid(prefix, newCount - prefix - suffix);
+    m_pageKeys = m_blockKeys;
+    if (removeCount == 0 && inserted.isEmpty()) {
+        return;
+    }
+
+    const QByteArray blocks = QJsonDocument(QJsonArray::fromStringList(inserted)).toJson(QJsonDocument::Compact);
+    m_webView->page()->runJavaScript(QStringLiteral("latexPreview.patch(%1, %2, %3);")
+                                         .arg(QString::number(prefix), QString::number(removeCount),
+                                              QString::fromUtf8(blocks)));
+}
+#endif
+
 void PreviewWindow::updateTheme(const Theme &theme) {
     QPalette palette = this->palette();
     palette.setColor(QPalette::Window, theme.windowColor);
@@ -41,4 +170,4 @@ void PreviewWindow::updateTheme(const Theme &theme) {
 #else
     m_textBrowser->setPalette(palette);
 #endif
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QTextBrowser>
+#include <QStringList>
 #include "../models/Theme.h"
 
 #ifdef QT_WEBENGINEWIDGETS_LIB
@@ -16,16 +17,27 @@ public:
     explicit PreviewWindow(QWidget *parent = nullptr);
 
 public slots:
-    void updatePreview(const QString &htmlContent);
+    // Shows the converted blocks inside the document shell. The web view loads
+    // the shell once and afterwards only replaces the blocks that changed.
+    void updatePreview(const QString &documentShell, const QStringList &blockKeys,
+                       const QStringList &blockHtml);
 
     void updateTheme(const Theme &theme);
 
 private:
 #ifdef QT_WEBENGINEWIDGETS_LIB
+    void onLoadFinished(bool ok);
+    void patchBlocks();
+
     QWebEngineView *m_webView;
+    bool m_pageLoaded;
+    QStringList m_pageKeys;     // Blocks currently shown by the page
 #else
     QTextBrowser *m_textBrowser;
 #endif
+    QString m_documentShell;
+    QStringList m_blockKeys;
+    QStringList m_blockHtml;
 };
 
-#endif // PREVIEWWINDOW_H
\ No newline at end of file
+#endif // PREVIEWWINDOW_H
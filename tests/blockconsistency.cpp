@@ -0,0 +1,117 @@
+// blockconsistency.cpp
+// Checks that converting a document block by block, as the preview cache and
+// the streaming conversion do, or in chunks on several threads gives the same
+// HTML as converting it in one pass, on hand-written boundary cases, worst-case inputs and randomly edited
+// documents. Exits with 1 on the first mismatch.
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QTextStream>
+#include "../src/bench/StressLaTeX.h"
+#include "../src/utils/LaTeXBlockCache.h"
+#include "../src/utils/LaTeXToHtmlConverter.h"
+
+namespace {
+
+// Constructs that cross the block boundaries found by the splitter
+QList<StressCase> boundaryCases() {
+    return {
+        {"multi-line-heading", "Intro.\n\n\\section{Long\n title}\nText.\n"},
+        {"multi-line-heading-nested", "\\subsection{A \\textbf{b\nc} d\n}\n\nText.\n"},
+        {"group-across-paragraphs", "\\textbf{one\n\ntwo}\n\nthree\n"},
+        {"table-across-paragraphs", "\\begin{tabular}{cc}\na & b \\\\\n\n\\end{tabular}\n"},
+        {"table-after-heading", "\\section{T}\n\\begin{tabular}{c}\nx\n\\section{U}\ny \\\\\n\\end{tabular}\n"},
+        {"math-across-paragraphs", "$x +\n\ny$\n\nz\n"},
+        {"display-math-across-heading", "\\[ a\n\\section{S}\nb \\]\n"},
+        {"argument-after-blank-line", "\\textbf\n\n{x}\n"},
+        {"item-before-blank-line", "\\begin{description}\n\\item\n\n[x] y\n\\end{description}\n"},
+        {"unclosed-heading", "\\section{Open\n\nText\n\n\\section{Next}\n"},
+        {"escaped-braces-in-heading", "\\section{a \\{ b}\nText \\}\n\nMore.\n"},
+    };
+}
+
+// Documents long enough to be converted in chunks, with state left open
+// across a \section where a chunk may start
+QList<StressCase> chunkedCases() {
+    const QString filler = QString("Some filler text with \\textbf{bold} words.\n\n").repeated(2000);
+    return {
+        {"chunked-closed", filler + "\\section{A}\n" + filler + "\\section{B}\n" + filler},
+        {"chunked-group-across-section", filler + "\\textbf{open\n\\section{A}\n" + filler + "}\n" + filler},
+        {"chunked-table-across-section", filler + "\\begin{tabular}{c}\nx\n\\section{A}\n" + filler
+            + "\\end{tabular}\n\\section{B}\n" + filler},
+        {"chunked-list-across-section", filler + "\\begin{itemize}\n\\item x\n\\section{A}\n" + filler
+            + "\\end{itemize}\n\\section{B}\n" + filler},
+    };
+}
+
+QString streamed(LaTeXToHtmlConverter &converter, const QString &content, bool fromDevice) {
+    QBuffer output;
+    output.open(QIODevice::WriteOnly);
+    if (fromDevice) {
+        QBuffer input;
+        input.setData(content.toUtf8());
+        input.open(QIODevice::ReadOnly);
+        converter.convertToHtml(&input, &output);
+    } else {
+        converter.convertToHtml(QStringView(content), &output);
+    }
+    return QString::fromUtf8(output.buffer());
+}
+
+bool check(const StressCase &input, LaTeXToHtmlConverter &converter, QTextStream &err) {
+    const QString expected = converter.convertBody(input.content);
+
+    // A fresh cache converts every block; a second run takes them from the cache
+    LaTeXBlockCache cache(converter);
+    for (int run = 0; run < 2; ++run) {
+        QString body;
+        cache.convertBody(input.content, body);
+        if (body != expected) {
+            err << "Block conversion differs from convertBody for " << input.name
+                << (run == 0 ? "" : " (cached)") << Qt::endl;
+            return false;
+        }
+    }
+
+    if (converter.convertBodyConcurrent(input.content) != expected) {
+        err << "Concurrent conversion differs from convertBody for " << input.name << Qt::endl;
+        return false;
+    }
+
+    // Lines read from a device always end in a newline
+    const QString document = converter.generateHtmlDocument(expected, false);
+    if (streamed(converter, input.content, false) != document) {
+        err << "Streaming conversion differs from convertToHtml for " << input.name << Qt::endl;
+        return false;
+    }
+    const QString terminated = input.content.endsWith(QLatin1Char('\n'))
+        ? input.content : input.content + QLatin1Char('\n');
+    if (streamed(converter, terminated, true)
+        != converter.generateHtmlDocument(converter.convertBody(terminated), false)) {
+        err << "Streaming conversion from a device differs from convertToHtml for " << input.name << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    QList<StressCase> cases = boundaryCases();
+    cases += StressLaTeX::generate(2000);
+    cases += StressLaTeX::mutate(200, 200, 1);
+    cases += chunkedCases();
+    cases += StressLaTeX::mutate(10, 8000, 1000);
+
+    LaTeXToHtmlConverter converter;
+    for (const StressCase &input : cases) {
+        if (!check(input, converter, err)) {
+            return 1;
+        }
+    }
+
+    err << cases.size() << " inputs converted consistently" << Qt::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+// incrementalconsistency.cpp
+// Checks that the incremental error check, as the editor runs it while
+// typing, finds the same errors as checking the whole document, after every
+// one of a series of random edits. Checks are also paused and cancelled on
+// the way, and edits are made while a check is paused. Exits with 1 on the
+// first mismatch.
+#include <QCoreApplication>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <algorithm>
+#include "../src/bench/StressLaTeX.h"
+#include "../src/bench/SyntheticLaTeX.h"
+#include "../src/utils/LaTeXErrorChecker.h"
+
+namespace {
+
+bool sameError(const LaTeXError &a, const LaTeXError &b) {
+    return a.line == b.line && a.column == b.column && a.length == b.length && a.number == b.number
+        && a.type == b.type && a.messageId == b.messageId && a.argument == b.argument
+        && a.argument2 == b.argument2;
+}
+
+QString describe(const LaTeXError &error) {
+    return QString("%1:%2 %3").arg(error.line + 1).arg(error.column + 1).arg(error.message());
+}
+
+// Reports the first difference between the incremental and the full result
+bool compare(const QString &name, int step, const QVector<LaTeXError> &incremental,
+             const QVector<LaTeXError> &full, QTextStream &err) {
+    for (qsizetype i = 0; i < std::max(incremental.size(), full.size()); ++i) {
+        if (i < incremental.size() && i < full.size() && sameError(incremental[i], full[i])) {
+            continue;
+        }
+        err << "Incremental check differs from checkDocument for " << name << " after edit " << step
+            << ", error " << i << ": "
+            << (i < incremental.size() ? describe(incremental[i]) : QString("none")) << " instead of "
+            << (i < full.size() ? describe(full[i]) : QString("none")) << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+// Edits 'input' 'steps' times and compares the two checks after each edit
+bool check(const StressCase &input, int steps, quint32 seed, QTextStream &err) {
+    LaTeXErrorChecker incremental;
+    LaTeXErrorChecker full;
+    QRandomGenerator random(seed);
+    QString text = input.content;
+
+    QVector<LaTeXError> errors;
+    incremental.checkIncremental(text, errors);
+
+    for (int step = 1; step <= steps; ++step) {
+        const int edits = 1 + static_cast<int>(random.bounded(3));
+        for (int i = 0; i < edits; ++i) {
+            StressLaTeX::edit(text, random);
+        }
+
+        // A cancelled check keeps the state of the previous one
+        if (random.bounded(8) == 0) {
+            QVector<LaTeXError> ignored;
+            incremental.checkIncremental(text, ignored, []() { return true; });
+        }
+
+        // Pause at a random line, as for the lines on screen, and sometimes
+        // edit again before the check continues
+        const int lineCount = static_cast<int>(text.count(QLatin1Char('\n'))) + 1;
+        int pauseAfterLine = random.bounded(2) == 0 ? static_cast<int>(random.bounded(lineCount)) : -1;
+        while (incremental.checkIncremental(text, errors, {}, pauseAfterLine)
+               == LaTeXErrorChecker::CheckStatus::Paused) {
+            if (random.bounded(4) == 0) {
+                StressLaTeX::edit(text, random);
+            }
+            pauseAfterLine = -1;
+        }
+
+        if (!compare(input.name, step, errors, full.checkDocument(text), err)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    QList<StressCase> cases;
+    for (quint32 seed = 1; seed <= 20; ++seed) {
+        cases.append(StressCase{QString("synthetic-%1").arg(seed), SyntheticLaTeX::generate(300, SyntheticMix(), seed)});
+    }
+    cases += StressLaTeX::generate(2000);
+    cases += StressLaTeX::mutate(20, 300, 100);
+
+    quint32 seed = 1;
+    for (const StressCase &input : cases) {
+        if (!check(input, 50, seed++, err)) {
+            return 1;
+        }
+    }
+
+    err << cases.size() << " documents checked incrementally and in full with the same results" << Qt::endl;
+    return 0;
+}